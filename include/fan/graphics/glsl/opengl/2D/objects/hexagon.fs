@@ -0,0 +1,18 @@
+R"(
+#version 130
+
+in vec4 instance_color;
+in vec2 instance_corner;
+
+out vec4 color;
+
+void main() {
+	// Pointy-top hexagon inscribed in the quad: vertices at the middle of the top and bottom edges and a
+	// quarter of the way down the sides
+	vec2 p = abs(instance_corner);
+	if (p.y + p.x * 0.5 > 1.0) {
+		discard;
+	}
+	color = instance_color;
+}
+)"
\ No newline at end of file
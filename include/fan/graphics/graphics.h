@@ -27,6 +27,7 @@ namespace fan_2d {
 			using fan_2d::opengl::line_t;
 			using fan_2d::opengl::rectangle_t;
 			using fan_2d::opengl::circle_t;
+			using fan_2d::opengl::hexagon_t;
 			using fan_2d::opengl::sprite_t;
 
 		#endif
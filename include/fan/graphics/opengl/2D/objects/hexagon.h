@@ -0,0 +1,38 @@
+#pragma once
+
+#include <fan/graphics/opengl/2D/objects/rectangle.h>
+
+namespace fan_2d {
+	namespace opengl {
+
+		// rectangle_t drawing a pointy-top hexagon inside each quad; size is half the quad's width and height,
+		// so hexagons tile with rows size.y * 1.5 apart, every other row shifted by size.x
+		struct hexagon_t : public rectangle_t {
+
+			hexagon_t() = default;
+
+			void open(fan::opengl::context_t* context) {
+				m_shader.open(context);
+
+				m_shader.set_vertex(
+					context,
+					#include <fan/graphics/glsl/opengl/2D/objects/hexagon.vs>
+				);
+
+				m_shader.set_fragment(
+					context,
+					#include <fan/graphics/glsl/opengl/2D/objects/hexagon.fs>
+				);
+
+				m_shader.compile(context);
+
+				m_glsl_buffer.open(context);
+				m_glsl_buffer.init(context, m_shader.id, element_byte_size);
+				m_queue_helper.open();
+				m_draw_node_reference = fan::uninitialized;
+			}
+
+		};
+
+	}
+}
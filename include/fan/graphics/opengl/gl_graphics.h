@@ -17,6 +17,7 @@
 #include <fan/graphics/opengl/2D/objects/line.h>
 #include <fan/graphics/opengl/2D/objects/rectangle.h>
 #include <fan/graphics/opengl/2D/objects/circle.h>
+#include <fan/graphics/opengl/2D/objects/hexagon.h>
 #include <fan/graphics/opengl/2D/objects/sprite.h>
 #include <fan/graphics/opengl/2D/objects/sprite0.h>
 #include <fan/graphics/opengl/2D/objects/yuv420p_renderer.h>
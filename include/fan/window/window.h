@@ -351,6 +351,9 @@ namespace fan {
 
 		uint32_t handle_events();
 
+		// sleeps until the next event arrives, for handle_events to process
+		void wait_events();
+
 		void* get_user_data() const;
 		void set_user_data(void* user_data);
 
@@ -0,0 +1,538 @@
+#include "BitGrid.h"
+#include "EvolveKernel.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <bit>
+
+BitGrid::BitGrid(int width, int height)
+	:
+	width_(width),
+	height_(height),
+	words_(((size_t)width + 63) / 64),
+	stride_(((size_t)width + 63) / 64 + 2),
+	tail_mask_((width & 63) ? (((uint64_t)1 << (width & 63)) - 1) : ~(uint64_t)0)
+{
+	cells_.assign(stride_ * ((size_t)height + 2), 0);
+	next_.assign(cells_.size(), 0);
+
+	tiles_x_ = (int)words_;
+	tiles_y_ = (height + tile_size - 1) / tile_size;
+	// Even an empty board must be computed once: under a B0 rule it comes alive
+	active_.assign((size_t)tiles_x_ * tiles_y_, 1);
+	tile_population_.assign(active_.size(), 0);
+	tile_dying_.assign(active_.size(), 0);
+}
+
+void BitGrid::clear() {
+	std::fill(cells_.begin(), cells_.end(), 0);
+	std::fill(ages_.begin(), ages_.end(), 0);
+	wake_all();
+}
+
+void BitGrid::wake_all() {
+	std::fill(active_.begin(), active_.end(), 1);
+	rehash();
+	for (int ty = 0; ty < tiles_y_; ty++) count_tiles(ty);
+	update_counts();
+}
+
+void BitGrid::rehash() {
+	hash_ = 0;
+	for (size_t i = 0; i < cells_.size(); i++) hash_ ^= hash_word(i, cells_[i]);
+	for (size_t i = 0; i < ages_.size(); i++) hash_ ^= hash_word(cells_.size() + i, ages_[i]);
+}
+
+bool BitGrid::delta(const BitGrid& other, Delta& delta) const {
+	delta.clear();
+	if (width_ != other.width_ || height_ != other.height_ || topology_ != other.topology_ || rule_ != other.rule_) return false;
+
+	for (size_t i = 0; i < cells_.size(); i++)
+	{
+		if (cells_[i] != other.cells_[i]) delta.emplace_back((uint32_t)i, cells_[i] ^ other.cells_[i]);
+	}
+	for (size_t i = 0; i < ages_.size(); i++)
+	{
+		if (ages_[i] != other.ages_[i]) delta.emplace_back((uint32_t)(cells_.size() + i), ages_[i] ^ other.ages_[i]);
+	}
+	return true;
+}
+
+void BitGrid::apply(const Delta& delta) {
+	// Tiles the delta touches, woken (and rechecked for dying cells if their ages changed) once at the end
+	enum : uint8_t { touched = 1, aged = 2 };
+	std::vector<uint8_t> tiles(active_.size(), 0);
+
+	for (const auto& [index, bits] : delta)
+	{
+		bool age = index >= cells_.size();
+		size_t i = age ? (index - cells_.size()) % cells_.size() : index;
+		uint64_t& word = age ? ages_[index - cells_.size()] : cells_[index];
+		hash_ ^= hash_word(index, word) ^ hash_word(index, word ^ bits);
+
+		size_t t = tile_index((int)(i % stride_ - 1) * 64, (int)(i / stride_) - 1);
+		if (!age) {
+			int change = std::popcount(word ^ bits) - std::popcount(word);
+			population_ += change;
+			tile_population_[t] += change;
+		}
+		tiles[t] |= age ? touched | aged : touched;
+		word ^= bits;
+	}
+
+	for (size_t t = 0; t < tiles.size(); t++)
+	{
+		if (!tiles[t]) continue;
+		int tx = (int)(t % tiles_x_), ty = (int)(t / tiles_x_);
+		wake(tx * tile_size, ty * tile_size);
+		if (tiles[t] & aged) tile_dying_[t] = tile_dying(tx, ty);
+	}
+	bounds_stale_ = true;
+}
+
+void BitGrid::set_topology(Topology topology) {
+	topology_ = topology;
+	wake_all();
+}
+
+void BitGrid::set_rule(const Rule& rule) {
+	if (rule == rule_) return;
+
+	rule_ = rule;
+	ages_.assign(cells_.size() * rule.age_planes(), 0);
+	wake_all();
+}
+
+bool BitGrid::clear_age(int x, int y) {
+	uint64_t bit = (uint64_t)1 << (x & 63);
+	bool dying = false;
+	for (size_t i = offset(x, y); i < ages_.size(); i += cells_.size())
+	{
+		dying |= (ages_[i] & bit) != 0;
+		hash_ ^= hash_word(cells_.size() + i, ages_[i]) ^ hash_word(cells_.size() + i, ages_[i] & ~bit);
+		ages_[i] &= ~bit;
+	}
+	return dying;
+}
+
+int BitGrid::state(int x, int y) const {
+	if (get(x, y)) return 1;
+
+	int age = 0, planes = rule_.age_planes();
+	for (int p = 0; p < planes; p++) age |= (int)((ages_[p * cells_.size() + offset(x, y)] >> (x & 63)) & 1) << p;
+	return age ? age + 1 : 0;
+}
+
+void BitGrid::row_states(int y, uint8_t* states) const {
+	const uint64_t* alive = row(y);
+	for (int x = 0; x < width_; x++) states[x] = (alive[x >> 6] >> (x & 63)) & 1;
+
+	int planes = rule_.age_planes();
+	if (planes == 0) return;
+
+	// Dying cells: state = age + 1, never alive at the same time
+	for (size_t i = 0; i < words_; i++)
+	{
+		const uint64_t* age = &ages_[(size_t)(y + 1) * stride_ + 1 + i];
+		uint64_t dying = 0;
+		for (int p = 0; p < planes; p++) dying |= age[p * cells_.size()];
+
+		while (dying) {
+			int bit = std::countr_zero(dying);
+			dying &= dying - 1;
+
+			int value = 0;
+			for (int p = 0; p < planes; p++) value |= (int)((age[p * cells_.size()] >> bit) & 1) << p;
+			states[i * 64 + bit] = (uint8_t)(value + 1);
+		}
+	}
+}
+
+void BitGrid::wake(int x, int y) {
+	int tx = x / tile_size, ty = y / tile_size;
+	for (int j = ty - 1; j <= ty + 1; j++)
+	{
+		for (int i = tx - 1; i <= tx + 1; i++) wake_tile(i, j);
+	}
+}
+
+void BitGrid::wake_tile(int tx, int ty) {
+	bool wraps = topology_ != Topology::plane;
+	if (!wraps && (tx < 0 || ty < 0 || tx >= tiles_x_ || ty >= tiles_y_)) return;
+
+	if (ty >= 0 && ty < tiles_y_) {
+		active_[(size_t)ty * tiles_x_ + (tx + tiles_x_) % tiles_x_] = 1;
+		return;
+	}
+
+	ty = (ty + tiles_y_) % tiles_y_;
+	if (topology_ == Topology::torus) {
+		active_[(size_t)ty * tiles_x_ + (tx + tiles_x_) % tiles_x_] = 1;
+		return;
+	}
+
+	// Klein bottle: the tile across the top or bottom edge is the mirror image of the columns, which can straddle two tiles
+	tx = (tx + tiles_x_) % tiles_x_;
+	int x0 = tx * tile_size, x1 = std::min(x0 + tile_size, width_) - 1;
+	for (int t = (width_ - 1 - x1) / tile_size; t <= (width_ - 1 - x0) / tile_size; t++) active_[(size_t)ty * tiles_x_ + t] = 1;
+}
+
+void BitGrid::refresh_halo() {
+	if (topology_ == Topology::plane) return;
+
+	// Rows first: the guard rows take the row across the edge, mirrored on a Klein bottle
+	auto copy_row = [&](int from, int to) {
+		uint64_t* dst = row(to);
+		const uint64_t* src = row(from);
+		if (topology_ == Topology::torus) {
+			std::copy(src, src + words_, dst);
+			return;
+		}
+		std::fill(dst, dst + words_, 0);
+		for (int x = 0; x < width_; x++)
+		{
+			int m = width_ - 1 - x;
+			dst[m >> 6] |= ((src[x >> 6] >> (x & 63)) & 1) << (m & 63);
+		}
+	};
+	copy_row(height_ - 1, -1);
+	copy_row(0, height_);
+
+	// Then columns, guard rows included so that the corners come out right
+	for (int y = -1; y <= height_; y++)
+	{
+		uint64_t* r = row(y);
+		uint64_t first = r[0] & 1;
+		uint64_t last = (r[(width_ - 1) >> 6] >> ((width_ - 1) & 63)) & 1;
+
+		r[-1] = last << 63;
+		if (width_ & 63) r[words_ - 1] |= first << (width_ & 63);
+		else r[words_] = first;
+	}
+}
+
+void BitGrid::clear_halo() {
+	if (topology_ == Topology::plane) return;
+
+	std::fill(row(-1) - 1, row(-1) - 1 + stride_, 0);
+	std::fill(row(height_) - 1, row(height_) - 1 + stride_, 0);
+	for (int y = 0; y < height_; y++)
+	{
+		uint64_t* r = row(y);
+		r[-1] = 0;
+		r[words_ - 1] &= tail_mask_;
+		r[words_] = 0;
+	}
+}
+
+size_t BitGrid::active_tiles() const {
+	return std::count(active_.begin(), active_.end(), 1);
+}
+
+uint64_t BitGrid::occupied(size_t i) const {
+	uint64_t word = cells_[i];
+	for (size_t plane = i; plane < ages_.size(); plane += cells_.size()) word |= ages_[plane];
+	return word;
+}
+
+void BitGrid::count_tiles(int ty) {
+	int y0 = ty * tile_size;
+	int y1 = std::min(y0 + tile_size, height_);
+
+	for (int tx = 0; tx < tiles_x_; tx++)
+	{
+		uint32_t count = 0;
+		for (int y = y0; y < y1; y++) count += std::popcount(row(y)[tx]);
+		tile_population_[(size_t)ty * tiles_x_ + tx] = count;
+		tile_dying_[(size_t)ty * tiles_x_ + tx] = !ages_.empty() && tile_dying(tx, ty);
+	}
+}
+
+void BitGrid::update_counts() {
+	population_ = 0;
+	for (uint32_t count : tile_population_) population_ += count;
+	update_bounds();
+}
+
+void BitGrid::update_bounds() const {
+	bounds_stale_ = false;
+	bounds_ = Bounds();
+
+	// Occupied tiles first, then the outermost occupied rows and columns within them
+	int tx0 = tiles_x_, tx1 = -1, ty0 = tiles_y_, ty1 = -1;
+	for (int ty = 0; ty < tiles_y_; ty++)
+	{
+		for (int tx = 0; tx < tiles_x_; tx++)
+		{
+			size_t t = (size_t)ty * tiles_x_ + tx;
+			if (tile_population_[t] == 0 && !tile_dying_[t]) continue;
+			tx0 = std::min(tx0, tx);
+			tx1 = std::max(tx1, tx);
+			ty0 = std::min(ty0, ty);
+			ty1 = std::max(ty1, ty);
+		}
+	}
+	if (tx1 < 0) return;
+
+	auto row_occupied = [&](int y) {
+		for (int tx = tx0; tx <= tx1; tx++)
+		{
+			if (occupied(offset(tx * 64, y))) return true;
+		}
+		return false;
+	};
+
+	int top = ty0 * tile_size, bottom = std::min((ty1 + 1) * tile_size, height_);
+	while (top < bottom && !row_occupied(top)) top++;
+	while (bottom > top && !row_occupied(bottom - 1)) bottom--;
+	if (top == bottom) return;
+
+	uint64_t left = 0, right = 0;
+	for (int y = top; y < bottom; y++)
+	{
+		left |= occupied(offset(tx0 * 64, y));
+		right |= occupied(offset(tx1 * 64, y));
+	}
+	if (left == 0 || right == 0) return;
+
+	bounds_ = { tx0 * 64 + std::countr_zero(left), top, tx1 * 64 + 64 - std::countl_zero(right), bottom };
+}
+
+enum TileChange : uint16_t {
+	changed = 1 << 0,
+	top = 1 << 1, bottom = 1 << 2, left = 1 << 3, right = 1 << 4,
+	top_left = 1 << 5, top_right = 1 << 6, bottom_left = 1 << 7, bottom_right = 1 << 8
+};
+
+uint16_t BitGrid::tile_changes(int tx, int ty, uint64_t& hash) {
+	int y0 = ty * tile_size;
+	int y1 = std::min(y0 + tile_size, height_);
+
+	// The last tile of a row may be narrower than a word, and a wrapping halo leaves a bit past its edge
+	int right_bit = tx == tiles_x_ - 1 ? (width_ - 1) & 63 : 63;
+	uint64_t mask = tx == tiles_x_ - 1 ? tail_mask_ : ~(uint64_t)0;
+
+	uint64_t any = 0, left_column = 0, right_column = 0, first = 0, last = 0;
+	uint32_t population = 0;
+	for (int y = y0; y < y1; y++)
+	{
+		size_t i = (size_t)(y + 1) * stride_ + 1 + tx;
+		uint64_t diff = (cells_[i] ^ next_[i]) & mask;
+		if (diff) hash ^= hash_word(i, cells_[i] & mask) ^ hash_word(i, next_[i]);
+		population += std::popcount(next_[i]);
+		any |= diff;
+		left_column |= diff & 1;
+		right_column |= (diff >> right_bit) & 1;
+		if (y == y0) first = diff;
+		if (y == y1 - 1) last = diff;
+	}
+	tile_population_[(size_t)ty * tiles_x_ + tx] = population;
+
+	uint16_t changes = 0;
+	if (any) changes |= changed;
+	if (first) changes |= top;
+	if (last) changes |= bottom;
+	if (left_column) changes |= left;
+	if (right_column) changes |= right;
+	if (first & 1) changes |= top_left;
+	if ((first >> right_bit) & 1) changes |= top_right;
+	if (last & 1) changes |= bottom_left;
+	if ((last >> right_bit) & 1) changes |= bottom_right;
+	return changes;
+}
+
+uint64_t BitGrid::tile_age_hash(int tx, int ty) const {
+	int y0 = ty * tile_size;
+	int y1 = std::min(y0 + tile_size, height_);
+
+	uint64_t hash = 0;
+	for (size_t plane = 0; plane < ages_.size(); plane += cells_.size())
+	{
+		for (int y = y0; y < y1; y++)
+		{
+			size_t i = plane + (size_t)(y + 1) * stride_ + 1 + tx;
+			hash ^= hash_word(cells_.size() + i, ages_[i]);
+		}
+	}
+	return hash;
+}
+
+bool BitGrid::tile_dying(int tx, int ty) const {
+	int y0 = ty * tile_size;
+	int y1 = std::min(y0 + tile_size, height_);
+
+	uint64_t any = 0;
+	for (size_t plane = 0; plane < ages_.size(); plane += cells_.size())
+	{
+		for (int y = y0; y < y1; y++) any |= ages_[plane + (size_t)(y + 1) * stride_ + 1 + tx];
+	}
+	return any != 0;
+}
+
+void BitGrid::evolve() {
+	if (width_ == 0 || height_ == 0) return;
+
+	const EvolveKernel& kernel = kernel_ != nullptr ? *kernel_ : EvolveKernels::selected();
+	std::vector<uint16_t> changes(active_.size(), 0);
+	std::vector<uint64_t> hash_changes(tiles_y_, 0);
+
+	refresh_halo();
+
+	// Rows of tiles are independent (each only writes its own tiles of next_ and changes), so they are
+	// spread over the thread pool without affecting the result
+	ThreadPool::shared().parallel_for(tiles_y_, [&](size_t ty) {
+		int y0 = (int)ty * tile_size;
+		int rows = std::min(tile_size, height_ - y0);
+		const uint8_t* active = &active_[ty * tiles_x_];
+		uint64_t& hash = hash_changes[ty];
+
+		// Runs of neighbouring awake tiles go through the kernel together to keep it vectorized
+		for (int tx = 0; tx < tiles_x_;)
+		{
+			if (!active[tx]) { tx++; continue; }
+
+			int run_end = tx;
+			while (run_end < tiles_x_ && active[run_end]) run_end++;
+
+			uint64_t* out = &next_[(size_t)(y0 + 1) * stride_ + 1];
+			kernel.evolve_rows(row(y0) + tx, out + tx, stride_, run_end - tx, rows, y0, rule_);
+
+			// Bits past the right edge picked up neighbours from the last column
+			if (run_end == tiles_x_) {
+				for (int y = 0; y < rows; y++) out[(size_t)y * stride_ + words_ - 1] &= tail_mask_;
+			}
+
+			if (!ages_.empty()) {
+				// Dying cells that just died no longer block births, so their tiles get one more generation
+				for (int t = tx; t < run_end; t++)
+				{
+					changes[ty * tiles_x_ + t] = tile_dying(t, (int)ty) ? changed : 0;
+					hash ^= tile_age_hash(t, (int)ty);
+				}
+
+				uint64_t* ages = &ages_[(size_t)(y0 + 1) * stride_ + 1];
+				kernel.age_rows(row(y0) + tx, out + tx, ages + tx, cells_.size(), rule_.age_planes(), rule_.states - 1, stride_, run_end - tx, rows);
+
+				// A wrapping halo puts a live bit past the right edge, which the kernel just turned into a dying one
+				if (run_end == tiles_x_) {
+					for (size_t plane = 0; plane < ages_.size(); plane += cells_.size())
+					{
+						for (int y = 0; y < rows; y++) ages[plane + (size_t)y * stride_ + words_ - 1] &= tail_mask_;
+					}
+				}
+
+				for (int t = tx; t < run_end; t++) hash ^= tile_age_hash(t, (int)ty);
+			}
+
+			for (; tx < run_end; tx++)
+			{
+				uint16_t& c = changes[ty * tiles_x_ + tx];
+				c |= tile_changes(tx, (int)ty, hash);
+				tile_dying_[ty * tiles_x_ + tx] = !ages_.empty() && tile_dying(tx, (int)ty);
+				if (tile_dying_[ty * tiles_x_ + tx]) c |= changed;
+			}
+		}
+	});
+
+	clear_halo();
+
+	for (uint64_t hash : hash_changes) hash_ ^= hash;
+
+	// Wake changed tiles and the neighbours across each changed edge or corner
+	std::fill(active_.begin(), active_.end(), 0);
+
+	for (int ty = 0; ty < tiles_y_; ty++)
+	{
+		for (int tx = 0; tx < tiles_x_; tx++)
+		{
+			uint16_t c = changes[(size_t)ty * tiles_x_ + tx];
+			if (!c) continue;
+
+			wake_tile(tx, ty);
+			if (c & top) wake_tile(tx, ty - 1);
+			if (c & bottom) wake_tile(tx, ty + 1);
+			if (c & left) wake_tile(tx - 1, ty);
+			if (c & right) wake_tile(tx + 1, ty);
+			if (c & top_left) wake_tile(tx - 1, ty - 1);
+			if (c & top_right) wake_tile(tx + 1, ty - 1);
+			if (c & bottom_left) wake_tile(tx - 1, ty + 1);
+			if (c & bottom_right) wake_tile(tx + 1, ty + 1);
+		}
+	}
+
+	cells_.swap(next_);
+	update_counts();
+}
+
+void BitGrid::evolve_blocked(int n) {
+	const EvolveKernel& kernel = kernel_ != nullptr ? *kernel_ : EvolveKernels::selected();
+
+	// Band height such that the band, its halo and the scratch copy of both stay in cache
+	size_t row_bytes = stride_ * sizeof(uint64_t);
+	int band = (int)std::max<size_t>(block_cache_bytes / (2 * row_bytes), tile_size) - 2 * n;
+	band = std::min(std::max(band, tile_size / 4), height_);
+	int bands = (height_ + band - 1) / band;
+	std::vector<uint64_t> hash_changes(bands, 0);
+
+	ThreadPool::shared().parallel_for(bands, [&](size_t b) {
+		int y0 = (int)b * band, y1 = std::min(y0 + band, height_);
+
+		// Band plus n rows of halo on either side, clipped to the board (beyond it cells stay dead anyway)
+		int top = std::max(y0 - n, 0), bottom = std::min(y1 + n, height_);
+		int rows = bottom - top;
+
+		thread_local std::vector<uint64_t> scratch[2];
+		for (std::vector<uint64_t>& buffer : scratch) buffer.assign(stride_ * ((size_t)rows + 2), 0);
+		std::copy(&cells_[(size_t)(top + 1) * stride_], &cells_[(size_t)(bottom + 1) * stride_], &scratch[0][stride_]);
+
+		// Rows still valid after each generation; the halo erodes by one row per generation except at the board's edges
+		int valid_top = 0, valid_bottom = rows;
+		for (int g = 0; g < n; g++)
+		{
+			if (top > 0) valid_top++;
+			if (bottom < height_) valid_bottom--;
+
+			uint64_t* src = &scratch[g & 1][(size_t)(valid_top + 1) * stride_ + 1];
+			uint64_t* dst = &scratch[(g + 1) & 1][(size_t)(valid_top + 1) * stride_ + 1];
+			kernel.evolve_rows(src, dst, stride_, words_, valid_bottom - valid_top, top + valid_top, rule_);
+			for (int y = 0; y < valid_bottom - valid_top; y++) dst[(size_t)y * stride_ + words_ - 1] &= tail_mask_;
+		}
+
+		const std::vector<uint64_t>& result = scratch[n & 1];
+		for (size_t i = (size_t)(y0 + 1) * stride_; i < (size_t)(y1 + 1) * stride_; i++)
+		{
+			uint64_t word = result[i - (size_t)top * stride_];
+			if (word != cells_[i]) hash_changes[b] ^= hash_word(i, cells_[i]) ^ hash_word(i, word);
+		}
+		std::copy(&result[(size_t)(y0 - top + 1) * stride_], &result[(size_t)(y1 - top + 1) * stride_], &next_[(size_t)(y0 + 1) * stride_]);
+	});
+
+	for (uint64_t hash : hash_changes) hash_ ^= hash;
+	cells_.swap(next_);
+}
+
+void BitGrid::evolve_n(int n) {
+	if (width_ == 0 || height_ == 0) return;
+
+	while (n > 0) {
+		// Mostly sleeping boards are cheaper tile by tile; bands do not see across wrapping edges nor carry ages
+		if (n == 1 || active_tiles() * 4 < active_.size() || topology_ != Topology::plane || !ages_.empty()) {
+			evolve();
+			n--;
+			continue;
+		}
+
+		int block = std::min(n, max_block_generations);
+		evolve_blocked(block);
+		n -= block;
+
+		// next_ now holds a generation from before the block, so no tile can be assumed asleep
+		std::fill(active_.begin(), active_.end(), 1);
+		ThreadPool::shared().parallel_for(tiles_y_, [&](size_t ty) { count_tiles((int)ty); });
+		update_counts();
+	}
+}
+
+bool BitGrid::operator==(const BitGrid& other) const {
+	return width_ == other.width_ && height_ == other.height_ && cells_ == other.cells_ && ages_ == other.ages_;
+}
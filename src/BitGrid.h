@@ -0,0 +1,262 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+#include "Rule.h"
+
+/// <summary>
+///
+/// Dense, bit-packed board: 64 cells per uint64_t, bit i of a word is column (word * 64 + i).
+/// Every row is padded with one guard word on each side and the board with one guard row above and below,
+/// so the evolve kernel can read all 8 neighbours of any cell without boundary checks.
+///
+/// The guards double as a ghost-cell halo: for wrapping topologies they are filled with the opposite edges
+/// once per generation, so the kernel itself never branches on the boundary.
+///
+/// Generations rules keep the age of dying cells in extra bitplanes with the same layout (structure of
+/// arrays), so the live plane stays a plain bitmap that the kernel and every other engine read as is.
+///
+/// The board is also split into 64x64 tiles (one word wide). Only tiles that changed last generation, or
+/// whose neighbour changed along their shared edge, are recomputed; still and empty regions sleep.
+///
+/// A Zobrist-style hash of the state is kept up to date from the words that change, so that repeated
+/// states can be recognised without comparing boards. The population is counted per tile as tiles are
+/// recomputed, and the bounding box of the occupied cells is narrowed down from the occupied tiles.
+///
+/// </summary>
+
+// How the edges of the board connect
+enum class Topology {
+	plane,	// Cells beyond the edges are dead
+	torus,	// Left meets right, top meets bottom
+	klein	// Left meets right, top meets bottom mirrored left to right
+};
+
+// Hash contribution of a word of cells at some position: the word mixed with a pseudo-random key for the
+// position. States hash to the XOR of their words' contributions, so a changed word updates the hash in O(1);
+// empty words contribute nothing
+inline uint64_t hash_word(uint64_t position, uint64_t word) {
+	if (word == 0) return 0;
+
+	auto mix = [](uint64_t h) {
+		h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ull;
+		h = (h ^ (h >> 27)) * 0x94d049bb133111ebull;
+		return h ^ (h >> 31);
+	};
+	return mix(word ^ mix(position + 0x9e3779b97f4a7c15ull));
+}
+
+struct EvolveKernel;
+
+class BitGrid
+{
+public:
+	// Half-open rectangle of cells
+	struct Bounds {
+		int left = 0, top = 0, right = 0, bottom = 0;
+
+		bool empty() const { return right <= left || bottom <= top; }
+		int width() const { return right - left; }
+		int height() const { return bottom - top; }
+	};
+
+	// Words that differ between two boards, as (index, XOR of the two words) with indices as in the hash
+	typedef std::vector<std::pair<uint32_t, uint64_t>> Delta;
+
+private:
+	Topology topology_ = Topology::plane;
+	Rule rule_;
+	const EvolveKernel* kernel_ = nullptr;
+
+	int width_ = 0;
+	int height_ = 0;
+
+	size_t words_ = 0;	// Words holding real cells per row
+	size_t stride_ = 0;	// Words per row including the two guard words
+
+	uint64_t tail_mask_ = 0; // Valid bits of the last word of every row
+
+	std::vector<uint64_t> cells_; // Current generation
+	std::vector<uint64_t> next_;  // Previous generation, overwritten with the next one and swapped with cells_
+
+	// Age of dying cells under a Generations rule: rule_.age_planes() bitplanes of cells_.size() words each,
+	// bit p of a cell's age in plane p; empty for two-state rules
+	std::vector<uint64_t> ages_;
+
+	// XOR of hash_word over every word of cells_ and ages_, by index into cells_ (ages_ continuing after it)
+	uint64_t hash_ = 0;
+
+	// Tiles to recompute next generation; a sleeping tile holds the same cells in both buffers
+	int tiles_x_ = 0;
+	int tiles_y_ = 0;
+	std::vector<uint8_t> active_;
+
+	// Live cells of each tile and in total, and the tiles holding dying cells
+	std::vector<uint32_t> tile_population_;
+	std::vector<uint8_t> tile_dying_;
+	uint64_t population_ = 0;
+
+	// Smallest rectangle holding every live or dying cell; a cell cleared by set() leaves it stale until
+	// the next query
+	mutable Bounds bounds_;
+	mutable bool bounds_stale_ = false;
+
+	size_t tile_index(int x, int y) const {
+		return (size_t)(y / tile_size) * tiles_x_ + (size_t)(x >> 6);
+	}
+
+	size_t offset(int x, int y) const {
+		return (size_t)(y + 1) * stride_ + 1 + (size_t)(x >> 6);
+	}
+
+	// Fill the halo with the cells across each edge, and zero it again once the kernel is done with it
+	void refresh_halo();
+	void clear_halo();
+
+	// Wake the tile holding (x, y) and the tiles around it
+	void wake(int x, int y);
+
+	// Wake the tile at (tx, ty), which may lie across an edge of the board
+	void wake_tile(int tx, int ty);
+
+	// Compares the freshly computed tile with its previous generation; returns which edges changed and adds
+	// the change in hash of the tile's cells to hash. Recounts the tile's population on the way
+	uint16_t tile_changes(int tx, int ty, uint64_t& hash);
+
+	// Hash of the ages of a tile's dying cells
+	uint64_t tile_age_hash(int tx, int ty) const;
+
+	// Recompute hash_ from scratch
+	void rehash();
+
+	// Recount the live and dying cells of a row of tiles
+	void count_tiles(int ty);
+
+	// Sum the tile populations and narrow the bounds down from the occupied tiles
+	void update_counts();
+	void update_bounds() const;
+
+	// Live cells and dying ones of a word of cells_
+	uint64_t occupied(size_t i) const;
+
+	// Whether the tile holds dying cells, which keep it awake until they are dead
+	bool tile_dying(int tx, int ty) const;
+
+	// Make the cell dead rather than dying; returns whether it was dying
+	bool clear_age(int x, int y);
+
+	// Temporal blocking pass: up to max_block_generations generations, band by band, into next_
+	void evolve_blocked(int n);
+
+public:
+	// Tile edge length in cells (tiles are one word wide)
+	static constexpr int tile_size = 64;
+
+	// Generations per temporal block, and the cache budget a band and its halo are sized for
+	static constexpr int max_block_generations = 16;
+	static constexpr size_t block_cache_bytes = 256 * 1024;
+
+	BitGrid() {}
+	BitGrid(int width, int height);
+
+	int width() const { return width_; }
+	int height() const { return height_; }
+	size_t words() const { return words_; }
+	size_t stride() const { return stride_; }
+	uint64_t tail_mask() const { return tail_mask_; }
+
+	// First real word of row y (y may be -1 or height() to reach the guard rows)
+	uint64_t* row(int y) { return &cells_[(size_t)(y + 1) * stride_ + 1]; }
+	const uint64_t* row(int y) const { return &cells_[(size_t)(y + 1) * stride_ + 1]; }
+
+	bool get(int x, int y) const {
+		return (cells_[offset(x, y)] >> (x & 63)) & 1;
+	}
+
+	void set(int x, int y, bool alive) {
+		uint64_t bit = (uint64_t)1 << (x & 63);
+		uint64_t& word = cells_[offset(x, y)];
+		bool changed = !ages_.empty() && clear_age(x, y);
+		if (((word & bit) != 0) != alive) {
+			hash_ ^= hash_word(offset(x, y), word) ^ hash_word(offset(x, y), word ^ bit);
+			word ^= bit;
+			changed = true;
+
+			population_ += alive ? 1 : -1;
+			tile_population_[tile_index(x, y)] += alive ? 1 : -1;
+		}
+		if (!changed) return;
+
+		wake(x, y);
+		if (!alive) bounds_stale_ = true;
+		else if (!bounds_stale_) {
+			if (bounds_.empty()) bounds_ = { x, y, x + 1, y + 1 };
+			bounds_ = { std::min(bounds_.left, x), std::min(bounds_.top, y), std::max(bounds_.right, x + 1), std::max(bounds_.bottom, y + 1) };
+		}
+	}
+
+	// 0 dead, 1 alive, 2 and up dying (Generations rules)
+	int state(int x, int y) const;
+
+	// States of row y, one byte per cell
+	void row_states(int y, uint8_t* states) const;
+
+	// Row kernel to evolve with instead of EvolveKernels::selected(), e.g. to compare kernels; nullptr for the default
+	void set_kernel(const EvolveKernel* kernel) { kernel_ = kernel; }
+
+	Topology topology() const { return topology_; }
+	void set_topology(Topology topology);
+
+	// Changing the rule turns dying cells dead
+	const Rule& rule() const { return rule_; }
+	void set_rule(const Rule& rule);
+
+	// Kill every cell
+	void clear();
+
+	// Recompute every tile next generation, e.g. after the words were written directly (which also rehashes)
+	void wake_all();
+
+	// Tiles that will be recomputed next generation
+	size_t active_tiles() const;
+
+	// Number of live cells
+	uint64_t population() const { return population_; }
+
+	// Memory the board's buffers take
+	size_t bytes() const {
+		return (cells_.capacity() + next_.capacity() + ages_.capacity()) * sizeof(uint64_t) + active_.capacity() + tile_dying_.capacity() + tile_population_.capacity() * sizeof(uint32_t);
+	}
+
+	// Smallest rectangle holding every live or dying cell; empty if there are none
+	const Bounds& bounds() const {
+		if (bounds_stale_) update_bounds();
+		return bounds_;
+	}
+
+	// Hash of the cells and, under a Generations rule, their ages; equal boards hash equally
+	uint64_t hash() const { return hash_; }
+
+	// The words where other differs from this board, so that apply() turns this board into other; false if
+	// the boards differ in size, topology or rule
+	bool delta(const BitGrid& other, Delta& delta) const;
+
+	// XOR the words of a delta into the board, updating the hash, counts and bounds and waking the tiles it
+	// touches; applying the same delta again undoes it
+	void apply(const Delta& delta);
+
+	// Proceed a generation
+	void evolve();
+
+	// Proceed n generations. Dense boards are cut into cache-sized bands of rows, each band advanced
+	// several generations in a row over a halo that shrinks by a row per generation before moving on
+	// (plane topology and two-state rules only; otherwise the board evolves one generation at a time)
+	void evolve_n(int n);
+
+	bool operator==(const BitGrid& other) const;
+	bool operator!=(const BitGrid& other) const { return !(*this == other); }
+};
@@ -0,0 +1,310 @@
+#include "Census.h"
+
+#include <algorithm>
+
+// Move a shape's bounding box to the origin and sort its cells, so that equal shapes compare equal
+static std::pair<int, int> normalize(Census::Shape& shape) {
+	int x0 = INT32_MAX, y0 = INT32_MAX;
+	for (const auto& [x, y] : shape)
+	{
+		x0 = std::min(x0, x);
+		y0 = std::min(y0, y);
+	}
+	for (auto& [x, y] : shape)
+	{
+		x -= x0;
+		y -= y0;
+	}
+	std::sort(shape.begin(), shape.end(), [](const auto& a, const auto& b) { return a.second != b.second ? a.second < b.second : a.first < b.first; });
+	return { x0, y0 };
+}
+
+std::string Census::wechsler(const Shape& shape) {
+	static const char digits[] = "0123456789abcdefghijklmnopqrstuvwxyz";
+
+	int width = 0, height = 0;
+	for (const auto& [x, y] : shape)
+	{
+		width = std::max(width, x + 1);
+		height = std::max(height, y + 1);
+	}
+
+	std::vector<uint8_t> columns((size_t)width * ((height + 4) / 5), 0);
+	for (const auto& [x, y] : shape) columns[(size_t)(y / 5) * width + x] |= 1 << (y % 5);
+
+	std::string code;
+	for (int strip = 0; strip < (height + 4) / 5; strip++)
+	{
+		if (strip > 0) code += 'z';
+
+		// Trailing blank columns are left out
+		int end = width;
+		while (end > 0 && columns[(size_t)strip * width + end - 1] == 0) end--;
+
+		for (int x = 0; x < end;)
+		{
+			uint8_t column = columns[(size_t)strip * width + x];
+			if (column != 0) {
+				code += digits[column];
+				x++;
+				continue;
+			}
+
+			// Blank runs: w for 2, x for 3, y followed by the count minus 4 for 4 to 39
+			int run = 0;
+			while (x + run < end && columns[(size_t)strip * width + x + run] == 0 && run < 39) run++;
+			x += run;
+			if (run == 1) code += '0';
+			else if (run == 2) code += 'w';
+			else if (run == 3) code += 'x';
+			else {
+				code += 'y';
+				code += digits[run - 4];
+			}
+		}
+	}
+	return code;
+}
+
+std::string Census::classify(const std::vector<Shape>& phases, const std::vector<std::pair<int, int>>& offsets) const {
+	// The object's own period divides the board's
+	size_t period = phases.size();
+	for (size_t q = 1; q < phases.size(); q++)
+	{
+		if (phases.size() % q == 0 && phases[q] == phases[0]) {
+			period = q;
+			break;
+		}
+	}
+
+	// Shortest encoding over the phases and symmetries, the alphabetically first among equally short ones
+	std::string best;
+	for (size_t t = 0; t < period; t++)
+	{
+		for (int symmetry = 0; symmetry < 8; symmetry++)
+		{
+			Shape image;
+			image.reserve(phases[t].size());
+			for (auto [x, y] : phases[t])
+			{
+				if (symmetry & 1) x = -x;
+				if (symmetry & 2) y = -y;
+				if (symmetry & 4) std::swap(x, y);
+				image.push_back({ x, y });
+			}
+			normalize(image);
+
+			std::string code = wechsler(image);
+			if (best.empty() || code.size() < best.size() || (code.size() == best.size() && code < best)) best = code;
+		}
+	}
+
+	if (period == 1) return "xs" + std::to_string(phases[0].size()) + "_" + best;
+	return (offsets[period % phases.size()] == offsets[0] ? "xp" : "xq") + std::to_string(period) + "_" + best;
+}
+
+std::vector<std::string> Census::objects(const BitGrid& board, uint64_t period) {
+	std::vector<std::string> codes;
+	if (period == 0 || period > max_period) return codes;
+
+	std::vector<BitGrid> phases(1, board);
+	for (uint64_t t = 1; t < period; t++)
+	{
+		phases.push_back(phases.back());
+		phases.back().evolve();
+	}
+
+	// Cells alive in any phase, within the region any phase reaches
+	int left = board.width(), top = board.height(), right = 0, bottom = 0;
+	for (const BitGrid& phase : phases)
+	{
+		const BitGrid::Bounds& bounds = phase.bounds();
+		if (bounds.empty()) continue;
+		left = std::min(left, bounds.left);
+		top = std::min(top, bounds.top);
+		right = std::max(right, bounds.right);
+		bottom = std::max(bottom, bounds.bottom);
+	}
+	if (right <= left) return codes;
+
+	int width = right - left, height = bottom - top;
+	std::vector<uint8_t> merged((size_t)width * height, 0);
+	for (const BitGrid& phase : phases)
+	{
+		for (int y = top; y < bottom; y++)
+		{
+			for (int x = left; x < right; x++) merged[(size_t)(y - top) * width + x - left] |= phase.get(x, y);
+		}
+	}
+
+	// Flood fill the 8-connected pieces out of the merged cells
+	std::vector<int> labels(merged.size(), -1);
+	std::vector<std::vector<std::pair<int, int>>> pieces;
+	std::vector<std::pair<int, int>> stack;
+	for (int start = 0; start < width * height; start++)
+	{
+		if (!merged[start] || labels[start] >= 0) continue;
+
+		int label = (int)pieces.size();
+		pieces.emplace_back();
+		stack.assign(1, { start % width, start / width });
+		labels[start] = label;
+		while (!stack.empty()) {
+			auto [x, y] = stack.back();
+			stack.pop_back();
+			pieces[label].push_back({ x, y });
+
+			for (int dy = -1; dy <= 1; dy++)
+			{
+				for (int dx = -1; dx <= 1; dx++)
+				{
+					int nx = x + dx, ny = y + dy;
+					if (nx < 0 || ny < 0 || nx >= width || ny >= height) continue;
+
+					size_t i = (size_t)ny * width + nx;
+					if (!merged[i] || labels[i] >= 0) continue;
+					labels[i] = label;
+					stack.push_back({ nx, ny });
+				}
+			}
+		}
+	}
+
+	// Pieces two cells apart may hold each other up, like the quarters of a pulsar; they are grouped, and the
+	// group only splits back into its pieces if each of them runs through the same phases on its own
+	std::vector<int> group(pieces.size());
+	for (size_t i = 0; i < group.size(); i++) group[i] = (int)i;
+	auto root = [&](int i) {
+		while (group[i] != i) i = group[i] = group[group[i]];
+		return i;
+	};
+	for (size_t label = 0; label < pieces.size(); label++)
+	{
+		for (const auto& [x, y] : pieces[label])
+		{
+			for (int dy = -2; dy <= 2; dy++)
+			{
+				for (int dx = -2; dx <= 2; dx++)
+				{
+					int nx = x + dx, ny = y + dy;
+					if (nx < 0 || ny < 0 || nx >= width || ny >= height) continue;
+
+					int other = labels[(size_t)ny * width + nx];
+					if (other >= 0) group[root(other)] = root((int)label);
+				}
+			}
+		}
+	}
+
+	auto independent = [&](const std::vector<std::pair<int, int>>& cells) {
+		int x0 = width, y0 = height, x1 = 0, y1 = 0;
+		for (const auto& [x, y] : cells)
+		{
+			x0 = std::min(x0, x);
+			y0 = std::min(y0, y);
+			x1 = std::max(x1, x + 1);
+			y1 = std::max(y1, y + 1);
+		}
+
+		// Room for the piece to grow by a cell per generation
+		int margin = (int)period + 1;
+		BitGrid alone(x1 - x0 + 2 * margin, y1 - y0 + 2 * margin);
+		alone.set_rule(board.rule());
+
+		for (uint64_t t = 0; t <= period; t++)
+		{
+			const BitGrid& phase = phases[t % period];
+			uint64_t population = 0;
+			for (const auto& [x, y] : cells)
+			{
+				bool alive = phase.get(x + left, y + top);
+				if (t == 0 && alive) alone.set(x - x0 + margin, y - y0 + margin, true);
+				if (alive != alone.get(x - x0 + margin, y - y0 + margin)) return false;
+				population += alive;
+			}
+			if (alone.population() != population) return false;
+			alone.evolve();
+		}
+		return true;
+	};
+
+	std::vector<std::vector<int>> members(pieces.size());
+	for (size_t label = 0; label < pieces.size(); label++) members[root((int)label)].push_back((int)label);
+
+	std::vector<std::vector<std::pair<int, int>>> objects;
+	for (const std::vector<int>& labels_in_group : members)
+	{
+		if (labels_in_group.empty()) continue;
+
+		bool split = labels_in_group.size() == 1;
+		if (!split) {
+			split = true;
+			for (int label : labels_in_group) split = split && independent(pieces[label]);
+		}
+
+		if (split) {
+			for (int label : labels_in_group) objects.push_back(std::move(pieces[label]));
+		}
+		else {
+			objects.emplace_back();
+			for (int label : labels_in_group) objects.back().insert(objects.back().end(), pieces[label].begin(), pieces[label].end());
+		}
+	}
+
+	const std::string rule = board.rule().to_string() + '\0';
+	for (const std::vector<std::pair<int, int>>& cells : objects)
+	{
+		std::vector<Shape> shapes(phases.size());
+		std::vector<std::pair<int, int>> offsets(phases.size());
+		for (size_t t = 0; t < phases.size(); t++)
+		{
+			for (const auto& [x, y] : cells)
+			{
+				if (phases[t].get(x + left, y + top)) shapes[t].push_back({ x, y });
+			}
+			if (!shapes[t].empty()) offsets[t] = normalize(shapes[t]);
+		}
+		if (shapes[0].empty()) continue;
+
+		// An object evolves the same wherever it is, so the shape it was found in names it under a rule
+		std::string key = rule;
+		key.append(reinterpret_cast<const char*>(shapes[0].data()), shapes[0].size() * sizeof(shapes[0][0]));
+
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			auto cached = codes_.find(key);
+			if (cached != codes_.end()) {
+				codes.push_back(cached->second);
+				continue;
+			}
+		}
+
+		std::string code = classify(shapes, offsets);
+		{
+			std::lock_guard<std::mutex> lock(mutex_);
+			codes_.emplace(key, code);
+		}
+		codes.push_back(code);
+	}
+	return codes;
+}
+
+bool Census::add(const BitGrid& board, uint64_t period) {
+	if (period == 0 || period > max_period) return false;
+
+	std::vector<std::string> codes = objects(board, period);
+
+	std::lock_guard<std::mutex> lock(mutex_);
+	for (const std::string& code : codes) counts_[code]++;
+	return true;
+}
+
+std::map<std::string, uint64_t> Census::counts() const {
+	std::lock_guard<std::mutex> lock(mutex_);
+	return counts_;
+}
+
+size_t Census::cached() const {
+	std::lock_guard<std::mutex> lock(mutex_);
+	return codes_.size();
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "BitGrid.h"
+
+/// <summary>
+///
+/// Classifies the ash of a settled board. The live cells of every phase of its cycle are merged, split into
+/// 8-connected objects, and each object is named by its apgcode as on Catagolue: xs<cells> for still lifes,
+/// xp<period> for oscillators and xq<period> for spaceships, followed by the extended Wechsler encoding of
+/// its smallest form over all phases and the 8 symmetries of the square.
+///
+/// Canonical forms are cached by the rule and the shape an object was first seen in, so repeated objects cost
+/// one lookup. A census can be shared by the threads of a soup search.
+///
+/// </summary>
+
+class Census
+{
+public:
+	// Boards cycling with a longer period are not taken apart
+	static constexpr uint64_t max_period = 256;
+
+	// Live cells of an object in one phase, as (x, y) pairs relative to its bounding box
+	typedef std::vector<std::pair<int, int>> Shape;
+
+private:
+	mutable std::mutex mutex_;
+
+	// Apgcode by the rule and the phase 0 shape an object was first met in
+	std::unordered_map<std::string, std::string> codes_;
+	std::map<std::string, uint64_t> counts_;
+
+	std::string classify(const std::vector<Shape>& phases, const std::vector<std::pair<int, int>>& offsets) const;
+
+public:
+	// Extended Wechsler encoding of a shape: strips of 5 rows, one character per column, zero runs shortened
+	static std::string wechsler(const Shape& shape);
+
+	// Apgcodes of the objects of a board that repeats every period generations
+	std::vector<std::string> objects(const BitGrid& board, uint64_t period);
+
+	// Count the objects of a board; false if its period is too long to take apart
+	bool add(const BitGrid& board, uint64_t period);
+
+	// Objects counted so far by apgcode
+	std::map<std::string, uint64_t> counts() const;
+
+	// Distinct shapes classified so far
+	size_t cached() const;
+};
@@ -0,0 +1,34 @@
+#include "CycleDetector.h"
+
+uint64_t CycleDetector::observe(uint64_t hash, uint64_t generation) {
+	if (!ring_.empty() && generation != last_generation_ + 1) gap_end_ = generation;
+	last_generation_ = generation;
+
+	uint64_t period = 0;
+	auto seen = by_hash_.find(hash);
+	if (seen != by_hash_.end()) {
+		period = generation - seen->second;
+		exact_ = seen->second >= gap_end_;
+	}
+
+	// Evict the oldest sighting unless its hash has been seen again since
+	if (ring_.size() < capacity) ring_.push_back({ hash, generation });
+	else {
+		Sighting& oldest = ring_[next_];
+		auto it = by_hash_.find(oldest.hash);
+		if (it != by_hash_.end() && it->second == oldest.generation) by_hash_.erase(it);
+		oldest = { hash, generation };
+	}
+	next_ = (next_ + 1) % capacity;
+	by_hash_[hash] = generation;
+
+	return period;
+}
+
+void CycleDetector::clear() {
+	ring_.clear();
+	next_ = 0;
+	by_hash_.clear();
+	last_generation_ = gap_end_ = 0;
+	exact_ = false;
+}
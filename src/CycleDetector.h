@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+/// <summary>
+///
+/// Remembers the board hashes of the last few thousand observed generations. Once a hash comes round again
+/// the board has entered a cycle, and the distance back to its last sighting is a period of it (the exact
+/// one if every generation in between was observed, a multiple of it otherwise).
+///
+/// </summary>
+
+class CycleDetector
+{
+public:
+	static constexpr size_t capacity = 4096;
+
+private:
+	struct Sighting {
+		uint64_t hash;
+		uint64_t generation;
+	};
+
+	// Oldest sightings are overwritten first; by_hash_ holds the latest generation of every hash in the ring
+	std::vector<Sighting> ring_;
+	size_t next_ = 0;
+	std::unordered_map<uint64_t, uint64_t> by_hash_;
+
+	// Last observation, and the latest generation that followed a skipped one
+	uint64_t last_generation_ = 0;
+	uint64_t gap_end_ = 0;
+	bool exact_ = false;
+
+public:
+	// Record the board hash at a generation, which must be later than the previous one; returns the
+	// generations since the same hash was last seen, or 0 if it is new
+	uint64_t observe(uint64_t hash, uint64_t generation);
+
+	// Whether the last period returned was found with every generation in between observed
+	bool exact() const { return exact_; }
+
+	// Forget every sighting, e.g. after the board was edited
+	void clear();
+};
@@ -0,0 +1,272 @@
+#include "DeltaCodec.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+
+namespace {
+
+// rANS with 12-bit probabilities and a 32-bit state renormalized a byte at a time
+constexpr uint32_t prob_bits = 12;
+constexpr uint32_t prob_scale = 1 << prob_bits;
+constexpr uint32_t rans_low = 1 << 23;
+
+// First byte of a packed delta
+enum Format : uint8_t { stored = 0, rans = 1 };
+
+void put_varint(std::vector<uint8_t>& out, uint64_t v) {
+	while (v >= 0x80) {
+		out.push_back((uint8_t)(v | 0x80));
+		v >>= 7;
+	}
+	out.push_back((uint8_t)v);
+}
+
+// Bytes left to read. Spilled deltas come back from disk, so every read is checked against the end
+struct Input {
+	const uint8_t* at;
+	const uint8_t* end;
+
+	size_t left() const { return (size_t)(end - at); }
+};
+
+bool get_varint(Input& in, uint64_t& v) {
+	v = 0;
+	for (int shift = 0; shift < 64 && in.at != in.end; shift += 7)
+	{
+		uint8_t byte = *in.at++;
+		v |= (uint64_t)(byte & 0x7f) << shift;
+		if (!(byte & 0x80)) return true;
+	}
+	return false;
+}
+
+// Signed values with small magnitudes as small varints, for tile coordinates on either side of the origin
+void put_signed(std::vector<uint8_t>& out, int64_t v) {
+	put_varint(out, ((uint64_t)v << 1) ^ (uint64_t)(v >> 63));
+}
+
+bool get_signed(Input& in, int64_t& v) {
+	uint64_t zigzag;
+	if (!get_varint(in, zigzag)) return false;
+	v = (int64_t)(zigzag >> 1) ^ -(int64_t)(zigzag & 1);
+	return true;
+}
+
+// A word as a mask of its non-zero bytes and those bytes; changed words mostly touch a byte or two
+void put_word(std::vector<uint8_t>& out, uint64_t word) {
+	size_t mask_at = out.size();
+	out.push_back(0);
+	for (int i = 0; i < 8; i++)
+	{
+		uint8_t byte = (uint8_t)(word >> (i * 8));
+		if (!byte) continue;
+		out[mask_at] |= 1 << i;
+		out.push_back(byte);
+	}
+}
+
+bool get_word(Input& in, uint64_t& word) {
+	if (in.at == in.end) return false;
+	uint8_t mask = *in.at++;
+	if (in.left() < (size_t)std::popcount(mask)) return false;
+
+	word = 0;
+	for (int i = 0; i < 8; i++)
+	{
+		if (mask & (1 << i)) word |= (uint64_t)*in.at++ << (i * 8);
+	}
+	return true;
+}
+
+// Symbol frequencies scaled to sum to prob_scale, every byte that occurs keeping at least 1
+std::array<uint32_t, 256> normalize(const std::vector<uint8_t>& bytes) {
+	std::array<uint64_t, 256> counts = {};
+	for (uint8_t byte : bytes) counts[byte]++;
+
+	std::array<uint32_t, 256> freqs = {};
+	uint32_t sum = 0;
+	for (int s = 0; s < 256; s++)
+	{
+		if (counts[s]) freqs[s] = std::max<uint32_t>(1, (uint32_t)(counts[s] * prob_scale / bytes.size()));
+		sum += freqs[s];
+	}
+
+	// Rounding leaves the sum a little off; the most frequent symbols absorb the difference
+	while (sum != prob_scale)
+	{
+		int largest = (int)(std::max_element(freqs.begin(), freqs.end()) - freqs.begin());
+		if (sum < prob_scale) {
+			freqs[largest] += prob_scale - sum;
+			sum = prob_scale;
+		}
+		else {
+			uint32_t take = std::min(sum - prob_scale, freqs[largest] - 1);
+			freqs[largest] -= take;
+			sum -= take;
+		}
+	}
+	return freqs;
+}
+
+std::vector<uint8_t> encode(const std::vector<uint8_t>& bytes) {
+	std::array<uint32_t, 256> freqs = normalize(bytes);
+	std::array<uint32_t, 256> starts = {};
+	for (int s = 1; s < 256; s++) starts[s] = starts[s - 1] + freqs[s - 1];
+
+	// rANS encodes back to front, so the output is built reversed and turned around at the end
+	std::vector<uint8_t> reversed;
+	reversed.reserve(bytes.size() / 2 + 16);
+	uint32_t x = rans_low;
+	for (size_t i = bytes.size(); i-- > 0;)
+	{
+		uint32_t freq = freqs[bytes[i]];
+		uint32_t x_max = ((rans_low >> prob_bits) << 8) * freq;
+		while (x >= x_max) {
+			reversed.push_back((uint8_t)x);
+			x >>= 8;
+		}
+		x = ((x / freq) << prob_bits) + (x % freq) + starts[bytes[i]];
+	}
+	for (int shift = 24; shift >= 0; shift -= 8) reversed.push_back((uint8_t)(x >> shift));
+
+	std::vector<uint8_t> out;
+	out.push_back(rans);
+	put_varint(out, bytes.size());
+	put_varint(out, (uint64_t)std::count_if(freqs.begin(), freqs.end(), [](uint32_t f) { return f != 0; }));
+	for (int s = 0; s < 256; s++)
+	{
+		if (!freqs[s]) continue;
+		out.push_back((uint8_t)s);
+		put_varint(out, freqs[s]);
+	}
+	out.insert(out.end(), reversed.rbegin(), reversed.rend());
+	return out;
+}
+
+bool decode(Input in, std::vector<uint8_t>& bytes) {
+	uint64_t size, symbols;
+	if (!get_varint(in, size) || !get_varint(in, symbols) || symbols == 0 || symbols > 256) return false;
+
+	std::array<uint32_t, 256> freqs = {}, starts = {};
+	std::vector<uint8_t> slots(prob_scale);
+	uint32_t start = 0;
+	for (size_t i = 0; i < symbols; i++)
+	{
+		uint64_t freq;
+		if (in.at == in.end) return false;
+		uint8_t s = *in.at++;
+		if (!get_varint(in, freq) || freq == 0 || freqs[s] != 0 || freq > prob_scale - start) return false;
+
+		freqs[s] = (uint32_t)freq;
+		starts[s] = start;
+		std::fill(slots.begin() + start, slots.begin() + start + freqs[s], s);
+		start += freqs[s];
+	}
+	if (start != prob_scale || in.left() < 4) return false;
+
+	// A symbol costs at least a 1/prob_scale of a bit unless it is the only one, which leaves little room for
+	// a size that does not fit the stream
+	if (size > (in.left() + 1) * 8 * prob_scale) return false;
+
+	uint32_t x = (uint32_t)in.at[0] | (uint32_t)in.at[1] << 8 | (uint32_t)in.at[2] << 16 | (uint32_t)in.at[3] << 24;
+	in.at += 4;
+
+	bytes.resize(size);
+	for (size_t i = 0; i < size; i++)
+	{
+		uint8_t s = slots[x & (prob_scale - 1)];
+		bytes[i] = s;
+		x = freqs[s] * (x >> prob_bits) + (x & (prob_scale - 1)) - starts[s];
+		while (x < rans_low)
+		{
+			if (in.at == in.end) return false;
+			x = (x << 8) | *in.at++;
+		}
+	}
+
+	// The encoder started from rans_low and wrote out every byte it shifted
+	return x == rans_low && in.at == in.end;
+}
+}
+
+std::vector<uint8_t> DeltaCodec::pack(const BitGrid::Delta& cells, const TileMap::Delta& plane) {
+	std::vector<uint8_t> bytes;
+
+	// Board words by the run of unchanged words before them
+	put_varint(bytes, cells.size());
+	uint64_t next = 0;
+	for (const auto& [index, word] : cells)
+	{
+		put_varint(bytes, index - next);
+		put_word(bytes, word);
+		next = (uint64_t)index + 1;
+	}
+
+	// Plane rows with their tile's coordinates whenever the tile changes, marked by bit 6 of the row
+	put_varint(bytes, plane.size());
+	for (size_t i = 0; i < plane.size(); i++)
+	{
+		bool new_tile = i == 0 || plane[i].key != plane[i - 1].key;
+		bytes.push_back((uint8_t)(plane[i].row | (new_tile ? 0x40 : 0)));
+		if (new_tile) { put_signed(bytes, plane[i].key.x); put_signed(bytes, plane[i].key.y); }
+		put_word(bytes, plane[i].bits);
+	}
+
+	std::vector<uint8_t> packed = encode(bytes);
+	if (packed.size() <= bytes.size()) return packed;
+
+	// Too little to gain from: stored as is
+	bytes.insert(bytes.begin(), stored);
+	return bytes;
+}
+
+bool DeltaCodec::unpack(const uint8_t* packed, size_t size, BitGrid::Delta& cells, TileMap::Delta& plane) {
+	cells.clear();
+	plane.clear();
+	if (packed == nullptr || size == 0) return false;
+
+	std::vector<uint8_t> decoded;
+	Input in = { packed + 1, packed + size };
+	if (packed[0] == rans) {
+		if (!decode(in, decoded)) return false;
+		in = { decoded.data(), decoded.data() + decoded.size() };
+	}
+	else if (packed[0] != stored) return false;
+
+	auto fail = [&]() {
+		cells.clear();
+		plane.clear();
+		return false;
+	};
+
+	// Every word takes at least a byte for its run and one for its mask, and every row a byte and a mask
+	uint64_t count;
+	if (!get_varint(in, count) || count > in.left() / 2) return fail();
+	cells.resize(count);
+	uint64_t next = 0;
+	for (auto& [index, word] : cells)
+	{
+		uint64_t run;
+		if (!get_varint(in, run) || run > UINT32_MAX - next || !get_word(in, word)) return fail();
+		index = (uint32_t)(next + run);
+		next = (uint64_t)index + 1;
+	}
+
+	if (!get_varint(in, count) || count > in.left() / 2) return fail();
+	plane.resize(count);
+	for (size_t i = 0; i < plane.size(); i++)
+	{
+		if (in.at == in.end) return fail();
+		uint8_t row = *in.at++;
+		bool new_tile = row & 0x40;
+		if ((row & 0x80) || (i == 0 && !new_tile)) return fail();
+
+		plane[i].row = row & 0x3f;
+		plane[i].key = i > 0 ? plane[i - 1].key : TileMap::Key{};
+		if (new_tile && (!get_signed(in, plane[i].key.x) || !get_signed(in, plane[i].key.y))) return fail();
+		if (!get_word(in, plane[i].bits)) return fail();
+	}
+	if (in.at != in.end) return fail();
+	return true;
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "BitGrid.h"
+#include "TileMap.h"
+
+/// <summary>
+///
+/// Compact encoding of board deltas for the history. The words of a delta are run-length encoded: each one
+/// as the run of unchanged words skipped before it and a mask of its non-zero bytes, followed by those bytes.
+/// The resulting byte stream is then entropy coded with a static order-0 rANS coder, which decodes about as
+/// fast as memory is read. Mostly empty boards shrink to a few bits per changed word.
+///
+/// </summary>
+
+class DeltaCodec
+{
+public:
+	// Encode the words of a board and of the plane; the board's are expected in order of index, and the
+	// plane's grouped by tile with rows in order, as BitGrid::delta() and TileMap::delta() list them
+	static std::vector<uint8_t> pack(const BitGrid::Delta& cells, const TileMap::Delta& plane);
+
+	// Decode what pack() made of a delta; false, with nothing decoded, if it is truncated or malformed
+	static bool unpack(const uint8_t* packed, size_t size, BitGrid::Delta& cells, TileMap::Delta& plane);
+};
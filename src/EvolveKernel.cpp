@@ -0,0 +1,373 @@
+#include "EvolveKernel.h"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <tuple>
+
+#ifdef CONGOL_X86
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#endif
+
+#include "EvolveKernel.inl"
+
+namespace {
+
+// Builds the decision diagram of a rule table. Every neighbourhood is reached through the cell, the count
+// planes and then the neighbours; paths whose count disagrees with their neighbours never occur and are
+// don't-cares, which lets a node merge its two branches whenever they agree wherever both are defined.
+// That collapses every count the rule decides as a whole into a constant right after the count planes
+class DiagramBuilder
+{
+private:
+	static constexpr int dont_care = 2; // Terminals are 0, 1 and dont_care; nodes start at 3
+
+	struct Node {
+		int variable, low, high;
+		bool operator<(const Node& other) const {
+			return std::tie(variable, low, high) < std::tie(other.variable, other.low, other.high);
+		}
+	};
+
+	const Rule& rule_;
+	std::vector<int> order_; // Variables from the root down
+	std::vector<Node> nodes_;
+	std::map<Node, int> unique_;
+
+	int node(int variable, int low, int high) {
+		if (low == high) return low;
+		Node key = { variable, low, high };
+		auto it = unique_.find(key);
+		if (it != unique_.end()) return it->second;
+
+		nodes_.push_back(key);
+		return unique_[key] = (int)nodes_.size() + 2;
+	}
+
+	const Node& at(int id) const { return nodes_[id - 3]; }
+
+	// Position of a node's variable in the order; terminals sit below every variable
+	int depth(int id) const {
+		if (id < 3) return (int)order_.size();
+		return (int)(std::find(order_.begin(), order_.end(), at(id).variable) - order_.begin());
+	}
+
+	// A function equal to both wherever both are defined, or -1 if they conflict
+	int merge(int a, int b) {
+		if (a == b || b == dont_care) return a;
+		if (a == dont_care) return b;
+		if (a < 3 && b < 3) return -1;
+
+		if (depth(a) > depth(b)) std::swap(a, b);
+		int variable = at(a).variable;
+		bool both = depth(a) == depth(b);
+		int low = merge(at(a).low, both ? at(b).low : b);
+		int high = merge(at(a).high, both ? at(b).high : b);
+		if (low < 0 || high < 0) return -1;
+		return node(variable, low, high);
+	}
+
+	int build(size_t level, unsigned neighbourhood, unsigned count, unsigned count_bits) {
+		if (level == order_.size()) {
+			if (count_bits != count) return dont_care;
+			return rule_.next(neighbourhood);
+		}
+
+		int variable = order_[level];
+		int branches[2];
+		for (unsigned value = 0; value < 2; value++)
+		{
+			if (variable < 9) branches[value] = build(level + 1, neighbourhood | (value << variable), count + (variable != 4 ? value : 0), count_bits);
+			else branches[value] = build(level + 1, neighbourhood, count, count_bits | (value << (variable - 9)));
+		}
+
+		int merged = merge(branches[0], branches[1]);
+		return merged >= 0 ? merged : node(variable, branches[0], branches[1]);
+	}
+
+public:
+	DiagramBuilder(const Rule& rule, const std::vector<int>& order) : rule_(rule), order_(order) {}
+
+	// Nodes reachable from the root, children first, numbered as DecisionDiagram values
+	std::vector<DecisionNode> compile() {
+		int root = build(0, 0, 0, 0);
+
+		std::vector<DecisionNode> result;
+		std::map<int, uint16_t> values = { { 0, 0 }, { 1, 1 } };
+		std::function<uint16_t(int)> emit = [&](int id) -> uint16_t {
+			auto it = values.find(id);
+			if (it != values.end()) return it->second;
+
+			uint16_t low = emit(at(id).low), high = emit(at(id).high);
+			result.push_back({ (uint8_t)at(id).variable, low, high });
+			return values[id] = (uint16_t)(result.size() + 1);
+		};
+		emit(root);
+
+		// A constant rule still needs a node to read the result from
+		if (result.empty()) result.push_back({ 4, (uint16_t)root, (uint16_t)root });
+		return result;
+	}
+};
+
+}
+
+// Everything a non-totalistic rule's next generation depends on
+static std::vector<uint64_t> table_key(const Rule& rule) {
+	std::vector<uint64_t> key(rule.table, rule.table + 8);
+	key.push_back(((uint64_t)rule.birth << 48) | ((uint64_t)rule.survival << 32) | ((uint64_t)rule.birth_partial << 16) | rule.survival_partial);
+	return key;
+}
+
+DecisionDiagram decision_diagram(const Rule& rule) {
+	static std::mutex mutex;
+	static std::map<std::vector<uint64_t>, std::unique_ptr<std::vector<DecisionNode>>> compiled;
+
+	std::vector<uint64_t> key = table_key(rule);
+
+	std::lock_guard<std::mutex> lock(mutex);
+	std::unique_ptr<std::vector<DecisionNode>>& nodes = compiled[key];
+	if (!nodes) {
+		// The cell and the count planes first, then the neighbours in whichever order gives the smallest diagram
+		const int neighbour_orders[][8] = {
+			{ 1, 5, 7, 3, 0, 2, 8, 6 },	// Edges, then corners
+			{ 1, 2, 5, 8, 7, 6, 3, 0 },	// Around the cell from the north
+			{ 0, 1, 2, 3, 5, 6, 7, 8 },	// Row by row
+		};
+		for (const int* neighbours : neighbour_orders)
+		{
+			std::vector<int> order = { 4, 12, 11, 10, 9 };
+			order.insert(order.end(), neighbours, neighbours + 8);
+
+			std::vector<DecisionNode> candidate = DiagramBuilder(rule, order).compile();
+			if (!nodes || candidate.size() < nodes->size()) nodes = std::make_unique<std::vector<DecisionNode>>(std::move(candidate));
+		}
+		assert(nodes->size() <= DecisionDiagram::max_nodes);
+	}
+
+	return { nodes->data(), nodes->size() };
+}
+
+const uint64_t* resolved_table(const Rule& rule) {
+	static std::mutex mutex;
+	static std::map<std::vector<uint64_t>, std::unique_ptr<uint64_t[]>> resolved;
+
+	std::vector<uint64_t> key = table_key(rule);
+
+	std::lock_guard<std::mutex> lock(mutex);
+	std::unique_ptr<uint64_t[]>& table = resolved[key];
+	if (!table) {
+		table = std::make_unique<uint64_t[]>(16);
+		for (unsigned neighbourhood = 0; neighbourhood < 512; neighbourhood++)
+		{
+			if (!rule.next(neighbourhood)) continue;
+
+			unsigned rotated = (neighbourhood >> 6) | ((neighbourhood & 0x3f) << 3);
+			table[neighbourhood >> 6] |= (uint64_t)1 << (neighbourhood & 63);
+			table[8 + (rotated >> 6)] |= (uint64_t)1 << (rotated & 63);
+		}
+	}
+
+	return table.get();
+}
+
+void evolve_rows_scalar(const uint64_t* src, uint64_t* dst, size_t stride, size_t words, int rows, int first_row, const Rule& rule) {
+	evolve_rows_rule<ScalarLane>(src, dst, stride, words, rows, first_row, rule);
+}
+
+void age_rows_scalar(const uint64_t* alive, uint64_t* next, uint64_t* ages, size_t plane_size, int planes, unsigned limit, size_t stride, size_t words, int rows) {
+	age_rows_lanes<ScalarLane>(alive, next, ages, plane_size, planes, limit, stride, words, rows);
+}
+
+#ifdef CONGOL_X86
+static void cpuid(uint32_t leaf, uint32_t subleaf, uint32_t regs[4]) {
+#ifdef _MSC_VER
+	__cpuidex((int*)regs, (int)leaf, (int)subleaf);
+#else
+	__cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+// Register state the OS saves on context switches (XCR0); wide registers are unusable unless it is enabled
+static uint64_t xgetbv0() {
+#ifdef _MSC_VER
+	return _xgetbv(0);
+#else
+	uint32_t eax, edx;
+	__asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+	return ((uint64_t)edx << 32) | eax;
+#endif
+}
+#endif
+
+std::vector<EvolveKernel> EvolveKernels::supported() {
+	std::vector<EvolveKernel> kernels = { { "lut", evolve_rows_lut, age_rows_scalar }, { "scalar", evolve_rows_scalar, age_rows_scalar } };
+
+#ifdef CONGOL_X86
+	uint32_t regs[4];
+	cpuid(0, 0, regs);
+	uint32_t max_leaf = regs[0];
+
+	cpuid(1, 0, regs);
+	bool sse2 = regs[3] & (1u << 26);
+	bool osxsave = regs[2] & (1u << 27);
+	if (sse2) kernels.push_back({ "sse2", evolve_rows_sse2, age_rows_sse2 });
+
+	if (!osxsave || max_leaf < 7) return kernels;
+
+	uint64_t xcr0 = xgetbv0();
+	bool os_avx = (xcr0 & 0x6) == 0x6;		// XMM and YMM state
+	bool os_avx512 = (xcr0 & 0xe6) == 0xe6;	// ... plus opmask and ZMM state
+
+	cpuid(7, 0, regs);
+	if (os_avx && (regs[1] & (1u << 5))) kernels.push_back({ "avx2", evolve_rows_avx2, age_rows_avx2 });
+	if (os_avx512 && (regs[1] & (1u << 16))) {
+		kernels.push_back({ "avx512", evolve_rows_avx512, age_rows_avx512 });
+		// Byte permutes and bit gathers (BW, VBMI, BITALG) for non-totalistic rules
+		if ((regs[1] & (1u << 30)) && (regs[2] & (1u << 1)) && (regs[2] & (1u << 12))) kernels.push_back({ "avx512vbmi", evolve_rows_avx512vbmi, age_rows_avx512 });
+	}
+#endif
+
+	return kernels;
+}
+
+// Filled in once by selected()
+static std::vector<const char*> rejected_kernels;
+
+const EvolveKernel& EvolveKernels::selected() {
+	static const EvolveKernel kernel = [] {
+		std::vector<EvolveKernel> kernels = supported();
+
+		// A kernel that miscomputes (a compiler or CPU erratum, or a bug on one instruction set) is dropped
+		// rather than trusted; scalar is the reference and always stays
+		self_check(333, 97, 16, 0x5eed, &rejected_kernels);
+		std::erase_if(kernels, [](const EvolveKernel& k) {
+			return std::find_if(rejected_kernels.begin(), rejected_kernels.end(), [&](const char* name) { return std::strcmp(name, k.name) == 0; }) != rejected_kernels.end();
+		});
+
+		const char* requested = std::getenv("CONGOL_KERNEL");
+		if (requested != nullptr) {
+			for (const EvolveKernel& k : kernels) {
+				if (std::strcmp(k.name, requested) == 0) return k;
+			}
+		}
+
+#ifndef CONGOL_X86
+		// Without a vector kernel the table lookups may beat counting 64 cells at a time, depending on the
+		// core's word size; time both on a small board
+		if (kernels.size() > 1 && benchmark(kernels[0], Rule(), 256, 16) < benchmark(kernels[1], Rule(), 256, 16)) return kernels[0];
+#endif
+		return kernels.back();
+	}();
+
+	return kernel;
+}
+
+const std::vector<const char*>& EvolveKernels::rejected() {
+	selected();
+	return rejected_kernels;
+}
+
+bool EvolveKernels::self_check(int width, int height, int generations, uint32_t seed, std::vector<const char*>* failing) {
+	// Same padded layout as BitGrid: guard word on both sides of a row, guard row above and below
+	size_t words = ((size_t)width + 63) / 64;
+	size_t stride = words + 2;
+	uint64_t tail_mask = (width & 63) ? (((uint64_t)1 << (width & 63)) - 1) : ~(uint64_t)0;
+
+	std::vector<uint64_t> soup(stride * ((size_t)height + 2), 0);
+	std::mt19937_64 random(seed);
+	for (int y = 0; y < height; y++)
+	{
+		uint64_t* row = &soup[(size_t)(y + 1) * stride + 1];
+		for (size_t i = 0; i < words; i++) row[i] = random();
+		row[words - 1] &= tail_mask;
+	}
+
+	// Every specialized kernel, plus rules that take the generic path with and without B0 and S8, a
+	// Generations rule with enough states to use most age planes, a non-totalistic rule and the other neighbourhoods
+	std::vector<Rule> rules;
+	for (const NamedRule& preset : preset_rules) rules.push_back(preset.rule);
+	rules.push_back(Rule((1 << 3) | (1 << 4), (1 << 3) | (1 << 4)));
+	rules.push_back(Rule(0x123, 0x10d));
+	rules.push_back(Rule((1 << 3) | (1 << 4), (1 << 1) | (1 << 2), 100));
+	Rule isotropic;
+	if (Rule::parse("B2n3-k4c/S1e23-q5y", isotropic)) rules.push_back(isotropic);
+	rules.push_back(Rule((1 << 2), (1 << 3) | (1 << 4), 2, Rule::Shape::hexagonal));
+	rules.push_back(Rule((1 << 1) | (1 << 3), (1 << 0) | (1 << 1) | (1 << 3), 2, Rule::Shape::von_neumann));
+
+	std::vector<EvolveKernel> kernels = supported();
+	std::vector<bool> differs(kernels.size(), false);
+
+	for (const Rule& rule : rules)
+	{
+		int planes = rule.age_planes();
+
+		auto run = [&](const EvolveKernel& kernel, std::vector<uint64_t>& cells, std::vector<uint64_t>& ages) {
+			std::vector<uint64_t> next(soup.size(), 0);
+			cells = soup;
+			ages.assign(soup.size() * planes, 0);
+			for (int g = 0; g < generations; g++)
+			{
+				kernel.evolve_rows(&cells[stride + 1], &next[stride + 1], stride, words, height, 0, rule);
+				for (int y = 0; y < height; y++) next[(size_t)(y + 1) * stride + words] &= tail_mask;
+				if (planes) kernel.age_rows(&cells[stride + 1], &next[stride + 1], &ages[stride + 1], soup.size(), planes, rule.states - 1, stride, words, height);
+				cells.swap(next);
+			}
+		};
+
+		std::vector<uint64_t> reference, reference_ages, cells, ages;
+		run({ "scalar", evolve_rows_scalar, age_rows_scalar }, reference, reference_ages);
+
+		for (size_t i = 0; i < kernels.size(); i++)
+		{
+			if (kernels[i].evolve_rows == evolve_rows_scalar && kernels[i].age_rows == age_rows_scalar) continue;
+			run(kernels[i], cells, ages);
+			if (cells != reference || ages != reference_ages) differs[i] = true;
+		}
+	}
+
+	bool identical = true;
+	for (size_t i = 0; i < kernels.size(); i++)
+	{
+		if (!differs[i]) continue;
+		identical = false;
+		if (failing != nullptr) failing->push_back(kernels[i].name);
+	}
+	return identical;
+}
+
+double EvolveKernels::benchmark(const EvolveKernel& kernel, const Rule& rule, int size, int generations) {
+	size_t words = ((size_t)size + 63) / 64;
+	size_t stride = words + 2;
+
+	std::vector<uint64_t> cells(stride * ((size_t)size + 2), 0), next(cells.size(), 0);
+	std::mt19937_64 random(0x5eed);
+	for (int y = 0; y < size; y++)
+	{
+		for (size_t i = 0; i < words; i++) cells[(size_t)(y + 1) * stride + 1 + i] = random();
+	}
+
+	// One generation first so that tables and diagrams are built outside the timing
+	kernel.evolve_rows(&cells[stride + 1], &next[stride + 1], stride, words, size, 0, rule);
+
+	auto start = std::chrono::steady_clock::now();
+	for (int g = 0; g < generations; g++)
+	{
+		kernel.evolve_rows(&cells[stride + 1], &next[stride + 1], stride, words, size, 0, rule);
+		cells.swap(next);
+	}
+	std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+
+	return elapsed.count() / ((double)words * 64 * size * generations);
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+#include "Rule.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define CONGOL_X86 1
+#endif
+
+/// <summary>
+///
+/// Row kernels computing one generation of a bit-packed (BitGrid layout) band, one per instruction set.
+/// The kernel is picked once at startup from what the CPU supports; the CONGOL_KERNEL environment variable
+/// (lut, scalar, sse2, avx2, avx512, avx512vbmi) overrides the choice when the host supports the requested kernel.
+///
+/// The lut kernel looks up 4x4 blocks in a table instead of counting bit-parallel; it needs no vector unit
+/// and no 64-bit arithmetic to speak of, for small 32-bit cores. The avx512vbmi kernel is the avx512 one
+/// except for non-totalistic rules, which it looks up cell by cell through byte permutes.
+///
+/// </summary>
+
+// src and dst point to the first word to compute of the first row; rows are stride words apart and the
+// words around the band (one row above/below, one word left/right) must be readable. The preset rules run
+// kernels specialized at compile time, non-totalistic rules their decision diagram (their resolved table
+// under avx512vbmi) and any other rule the generic kernel. first_row is the board row src is on, which hexagonal rules need for its parity
+typedef void (*evolve_rows_t)(const uint64_t* src, uint64_t* dst, size_t stride, size_t words, int rows, int first_row, const Rule& rule);
+
+// Generations rules: applied to a band after evolve_rows. alive is the band before the generation, next the
+// output of evolve_rows, ages the first of planes bitplanes (plane_size words apart, same layout) holding the
+// age of dying cells; limit is the state count - 1
+typedef void (*age_rows_t)(const uint64_t* alive, uint64_t* next, uint64_t* ages, size_t plane_size, int planes, unsigned limit, size_t stride, size_t words, int rows);
+
+// Non-totalistic rules run as a decision diagram over the cell, its neighbour count and its neighbours,
+// compiled from Rule::table. Node i selects value high where its variable is set and value low elsewhere;
+// values 0 and 1 are the constants and value i + 2 is node i, so nodes only refer to earlier ones and the
+// last node is the next generation
+struct DecisionNode {
+	uint8_t variable; // Bit of Rule::table (the cell and its neighbours), or 9 + bit of the neighbour count
+	uint16_t low, high;
+};
+
+struct DecisionDiagram {
+	static constexpr size_t max_nodes = 1024; // Enough for any table: its counts leave at most 18 distinct functions of the neighbours
+
+	const DecisionNode* nodes;
+	size_t size;
+};
+
+// Compiled on first use of a rule and kept for the rest of the run
+DecisionDiagram decision_diagram(const Rule& rule);
+
+// Rule::next of every neighbourhood, laid out as Rule::table (which only holds the partial counts), then
+// again with the rows in the order south, north, middle; for kernels that look each cell up directly, built
+// on first use like the diagram
+const uint64_t* resolved_table(const Rule& rule);
+
+struct EvolveKernel {
+	const char* name;
+	evolve_rows_t evolve_rows;
+	age_rows_t age_rows;
+};
+
+void evolve_rows_lut(const uint64_t* src, uint64_t* dst, size_t stride, size_t words, int rows, int first_row, const Rule& rule);
+void evolve_rows_scalar(const uint64_t* src, uint64_t* dst, size_t stride, size_t words, int rows, int first_row, const Rule& rule);
+void age_rows_scalar(const uint64_t* alive, uint64_t* next, uint64_t* ages, size_t plane_size, int planes, unsigned limit, size_t stride, size_t words, int rows);
+#ifdef CONGOL_X86
+void evolve_rows_sse2(const uint64_t* src, uint64_t* dst, size_t stride, size_t words, int rows, int first_row, const Rule& rule);
+void age_rows_sse2(const uint64_t* alive, uint64_t* next, uint64_t* ages, size_t plane_size, int planes, unsigned limit, size_t stride, size_t words, int rows);
+void evolve_rows_avx2(const uint64_t* src, uint64_t* dst, size_t stride, size_t words, int rows, int first_row, const Rule& rule);
+void age_rows_avx2(const uint64_t* alive, uint64_t* next, uint64_t* ages, size_t plane_size, int planes, unsigned limit, size_t stride, size_t words, int rows);
+void evolve_rows_avx512(const uint64_t* src, uint64_t* dst, size_t stride, size_t words, int rows, int first_row, const Rule& rule);
+void age_rows_avx512(const uint64_t* alive, uint64_t* next, uint64_t* ages, size_t plane_size, int planes, unsigned limit, size_t stride, size_t words, int rows);
+void evolve_rows_avx512vbmi(const uint64_t* src, uint64_t* dst, size_t stride, size_t words, int rows, int first_row, const Rule& rule);
+#endif
+
+class EvolveKernels {
+public:
+	// Every kernel the running CPU can execute, slowest first
+	static std::vector<EvolveKernel> supported();
+
+	// Kernel used by BitGrid::evolve; the fastest supported one unless overridden by CONGOL_KERNEL (without
+	// vector kernels, whichever of lut and scalar times faster at startup). Kernels that fail self_check() at
+	// startup are never selected
+	static const EvolveKernel& selected();
+
+	// Names of the kernels selected() dropped because they disagreed with the scalar kernel
+	static const std::vector<const char*>& rejected();
+
+	// Runs every supported kernel over the same random soup under several rules and compares the generations bit
+	// for bit with the scalar kernel's; the names of the kernels that differ are added to failing
+	static bool self_check(int width = 333, int height = 97, int generations = 16, uint32_t seed = 0x5eed, std::vector<const char*>* failing = nullptr);
+
+	// Nanoseconds per cell and generation of a kernel on a single thread, evolving a random square board
+	static double benchmark(const EvolveKernel& kernel, const Rule& rule, int size = 1024, int generations = 64);
+};
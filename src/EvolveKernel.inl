@@ -0,0 +1,386 @@
+// Shared body of the evolve kernels, included once per instruction set by EvolveKernel*.cpp.
+// Only raw pointers are used here: the including file may have switched the target ISA, so nothing from
+// the standard library may be instantiated below this point.
+
+namespace {
+
+struct ScalarLane {
+	typedef uint64_t type;
+	static constexpr size_t width = 1;
+
+	static constexpr bool ternary_logic = false;
+
+	static type broadcast(uint64_t v) { return v; }
+	static type load(const uint64_t* p) { return *p; }
+	static void store(uint64_t* p, type v) { *p = v; }
+	static type or_(type a, type b) { return a | b; }
+	static type and_(type a, type b) { return a & b; }
+	static type xor_(type a, type b) { return a ^ b; }
+	static type andnot(type a, type b) { return ~a & b; }
+	static type xor3(type a, type b, type c) { return a ^ b ^ c; }
+	static type maj(type a, type b, type c) { return (a & b) | (c & (a ^ b)); }
+	static type shl(type v, int n) { return v << n; }
+	static type shr(type v, int n) { return v >> n; }
+};
+
+// Truth table of the rule for neighbour counts base..base+3, indexed by alive << 2 | twos << 1 | ones
+constexpr unsigned rule_table(unsigned birth, unsigned survival, unsigned base) {
+	unsigned table = 0;
+	for (unsigned i = 0; i < 8; i++)
+	{
+		unsigned count = base + (i & 3);
+		if (count <= 8 && ((((i & 4) ? survival : birth) >> count) & 1)) table |= 1u << i;
+	}
+	return table;
+}
+
+// Truth table of the rule for 8 neighbours, which the low table sees as 0; a function of alive only
+constexpr unsigned eight_table(unsigned birth, unsigned survival) {
+	return (((birth >> 8) & 1) ? 0x0fu : 0) | (((survival >> 8) & 1) ? 0xf0u : 0);
+}
+
+template <class V>
+inline typename V::type choose(typename V::type s, typename V::type a, typename V::type b) {
+	if constexpr (V::ternary_logic) return V::template ternary<0xca>(s, a, b);
+	else return V::or_(V::and_(s, a), V::andnot(s, b));
+}
+
+// Boolean function of (b, c) from its 4-entry truth table, indexed by b << 1 | c
+template <class V, unsigned Table>
+inline typename V::type function2(typename V::type b, typename V::type c) {
+	if constexpr (Table == 0x0) return V::broadcast(0);
+	else if constexpr (Table == 0x1) return V::andnot(V::or_(b, c), V::broadcast(~(uint64_t)0));
+	else if constexpr (Table == 0x2) return V::andnot(b, c);
+	else if constexpr (Table == 0x3) return V::andnot(b, V::broadcast(~(uint64_t)0));
+	else if constexpr (Table == 0x4) return V::andnot(c, b);
+	else if constexpr (Table == 0x5) return V::andnot(c, V::broadcast(~(uint64_t)0));
+	else if constexpr (Table == 0x6) return V::xor_(b, c);
+	else if constexpr (Table == 0x7) return V::andnot(V::and_(b, c), V::broadcast(~(uint64_t)0));
+	else if constexpr (Table == 0x8) return V::and_(b, c);
+	else if constexpr (Table == 0x9) return V::andnot(V::xor_(b, c), V::broadcast(~(uint64_t)0));
+	else if constexpr (Table == 0xa) return c;
+	else if constexpr (Table == 0xb) return V::andnot(V::andnot(c, b), V::broadcast(~(uint64_t)0));
+	else if constexpr (Table == 0xc) return b;
+	else if constexpr (Table == 0xd) return V::andnot(V::andnot(b, c), V::broadcast(~(uint64_t)0));
+	else if constexpr (Table == 0xe) return V::or_(b, c);
+	else return V::broadcast(~(uint64_t)0);
+}
+
+// Boolean function of (a, b, c) from its 8-entry truth table, indexed by a << 2 | b << 1 | c
+template <class V, unsigned Table>
+inline typename V::type function3(typename V::type a, typename V::type b, typename V::type c) {
+	constexpr unsigned when_clear = Table & 0xf, when_set = Table >> 4;
+
+	if constexpr (V::ternary_logic) return V::template ternary<Table>(a, b, c);
+	else if constexpr (when_clear == when_set) return function2<V, when_clear>(b, c);
+	else if constexpr (when_clear == 0) return V::and_(a, function2<V, when_set>(b, c));
+	else if constexpr (when_set == 0) return V::andnot(a, function2<V, when_clear>(b, c));
+	else if constexpr ((when_clear & ~when_set) == 0) return V::or_(function2<V, when_clear>(b, c), V::and_(a, function2<V, when_set>(b, c)));
+	else if constexpr ((when_set & ~when_clear) == 0) return V::or_(function2<V, when_set>(b, c), V::andnot(a, function2<V, when_clear>(b, c)));
+	else return choose<V>(a, function2<V, when_set>(b, c), function2<V, when_clear>(b, c));
+}
+
+// Rule known at compile time: counts 0-3 and 4-7 each reduce to a fixed three-input function
+template <unsigned Birth, unsigned Survival>
+struct StaticRule {
+	explicit StaticRule(const Rule&) {}
+
+	template <class V>
+	typename V::type apply(typename V::type alive, typename V::type ones, typename V::type twos, typename V::type fours, typename V::type eights) const {
+		typedef typename V::type T;
+		constexpr unsigned low = rule_table(Birth, Survival, 0), high = rule_table(Birth, Survival, 4);
+		constexpr unsigned eight = eight_table(Birth, Survival);
+
+		T next;
+		if constexpr (low == high) next = function3<V, low>(alive, twos, ones);
+		else if constexpr (high == 0) next = V::andnot(fours, function3<V, low>(alive, twos, ones));
+		else if constexpr (low == 0) next = V::and_(fours, function3<V, high>(alive, twos, ones));
+		else next = choose<V>(fours, function3<V, high>(alive, twos, ones), function3<V, low>(alive, twos, ones));
+
+		if constexpr (eight != ((low & 0x11) * 0xf)) next = choose<V>(eights, function3<V, eight>(alive, twos, ones), next);
+		return next;
+	}
+};
+
+// Any other rule: the same decomposition with the truth tables evaluated as multiplexer trees at run time
+struct DynamicRule {
+	uint64_t low[8], high[8], eight[2];
+
+	explicit DynamicRule(const Rule& rule) {
+		unsigned low_table = rule_table(rule.birth, rule.survival, 0), high_table = rule_table(rule.birth, rule.survival, 4);
+		for (int i = 0; i < 8; i++)
+		{
+			low[i] = ((low_table >> i) & 1) ? ~(uint64_t)0 : 0;
+			high[i] = ((high_table >> i) & 1) ? ~(uint64_t)0 : 0;
+		}
+		eight[0] = ((rule.birth >> 8) & 1) ? ~(uint64_t)0 : 0;
+		eight[1] = ((rule.survival >> 8) & 1) ? ~(uint64_t)0 : 0;
+	}
+
+	template <class V>
+	static typename V::type lookup(const uint64_t table[8], typename V::type a, typename V::type b, typename V::type c) {
+		typedef typename V::type T;
+		T t[8];
+		for (int i = 0; i < 8; i++) t[i] = V::broadcast(table[i]);
+		T when_clear = choose<V>(b, choose<V>(c, t[3], t[2]), choose<V>(c, t[1], t[0]));
+		T when_set = choose<V>(b, choose<V>(c, t[7], t[6]), choose<V>(c, t[5], t[4]));
+		return choose<V>(a, when_set, when_clear);
+	}
+
+	template <class V>
+	typename V::type apply(typename V::type alive, typename V::type ones, typename V::type twos, typename V::type fours, typename V::type eights) const {
+		typename V::type next = choose<V>(fours, lookup<V>(high, alive, twos, ones), lookup<V>(low, alive, twos, ones));
+		return choose<V>(eights, choose<V>(alive, V::broadcast(eight[1]), V::broadcast(eight[0])), next);
+	}
+};
+
+// The cells around a lane-width of cells, each shifted onto the cell's own bit, in Rule::table order (the
+// cell itself in the middle), followed by the ones, twos, fours and eights planes of the neighbour count;
+// n, c and s are the rows above, at and below the cells
+template <class V>
+inline void neighbourhood_planes(const uint64_t* n, const uint64_t* c, const uint64_t* s, typename V::type planes[13]) {
+	typedef typename V::type T;
+
+	T n0 = V::load(n), c0 = V::load(c), s0 = V::load(s);
+
+	// Shift the neighbouring columns onto the cell's own bit, borrowing the edge bit from the adjacent word
+	T nw = V::or_(V::shl(n0, 1), V::shr(V::load(n - 1), 63)), ne = V::or_(V::shr(n0, 1), V::shl(V::load(n + 1), 63));
+	T w = V::or_(V::shl(c0, 1), V::shr(V::load(c - 1), 63)), e = V::or_(V::shr(c0, 1), V::shl(V::load(c + 1), 63));
+	T sw = V::or_(V::shl(s0, 1), V::shr(V::load(s - 1), 63)), se = V::or_(V::shr(s0, 1), V::shl(V::load(s + 1), 63));
+
+	// Carry-save neighbour count: ones, twos, fours and eights planes
+	T top_sum = V::xor3(nw, n0, ne), top_carry = V::maj(nw, n0, ne);
+	T bottom_sum = V::xor3(sw, s0, se), bottom_carry = V::maj(sw, s0, se);
+	T middle_sum = V::xor_(w, e), middle_carry = V::and_(w, e);
+
+	T ones = V::xor3(top_sum, bottom_sum, middle_sum), ones_carry = V::maj(top_sum, bottom_sum, middle_sum);
+	T twos_sum = V::xor3(top_carry, bottom_carry, middle_carry), twos_carry = V::maj(top_carry, bottom_carry, middle_carry);
+	T twos = V::xor_(twos_sum, ones_carry), fours_carry = V::and_(twos_sum, ones_carry);
+	T fours = V::xor_(twos_carry, fours_carry);
+	T eights = V::and_(twos_carry, fours_carry);
+
+	planes[0] = nw; planes[1] = n0; planes[2] = ne;
+	planes[3] = w; planes[4] = c0; planes[5] = e;
+	planes[6] = sw; planes[7] = s0; planes[8] = se;
+	planes[9] = ones; planes[10] = twos; planes[11] = fours; planes[12] = eights;
+}
+
+// One lane-width of cells of an outer-totalistic rule
+template <class V, class R>
+inline void evolve_lane(const uint64_t* n, const uint64_t* c, const uint64_t* s, uint64_t* out, const R& rule) {
+	typename V::type planes[13];
+	neighbourhood_planes<V>(n, c, s, planes);
+	V::store(out, rule.template apply<V>(planes[4], planes[9], planes[10], planes[11], planes[12]));
+}
+
+template <class V, class R>
+void evolve_rows_lanes(const uint64_t* src, uint64_t* dst, size_t stride, size_t words, int rows, const Rule& rule) {
+	R policy(rule);
+
+	for (int y = 0; y < rows; y++)
+	{
+		const uint64_t* c = src + (size_t)y * stride;
+		const uint64_t* n = c - stride;
+		const uint64_t* s = c + stride;
+		uint64_t* out = dst + (size_t)y * stride;
+
+		size_t i = 0;
+		for (; i + V::width <= words; i += V::width) evolve_lane<V>(n + i, c + i, s + i, out + i, policy);
+		for (; i < words; i++) evolve_lane<ScalarLane>(n + i, c + i, s + i, out + i, policy);
+	}
+}
+
+// Isotropic non-totalistic rules: the rule's table compiled into a decision diagram (see decision_diagram).
+// The nodes are walked once per batch of words rather than per lane, each one a single pass over the batch,
+// so interpreting the diagram costs little next to the work per node. Counts the rule decides as a whole
+// settle within the first few nodes; only the partial counts look at the neighbours themselves. It still
+// runs several times slower than counting; CPUs with AVX-512 byte permutes look the cells up directly instead
+// (evolve_rows_avx512vbmi)
+template <class V>
+void evolve_rows_isotropic(const uint64_t* src, uint64_t* dst, size_t stride, size_t words, int rows, const Rule& rule) {
+	constexpr size_t batch = 8; // Words per pass, a multiple of every lane width
+	const DecisionDiagram diagram = decision_diagram(rule);
+
+	// values[0] and values[1] are the constants, values[i + 2] node i
+	uint64_t inputs[13][batch] = {};
+	uint64_t values[DecisionDiagram::max_nodes + 2][batch];
+	for (size_t k = 0; k < batch; k++)
+	{
+		values[0][k] = 0;
+		values[1][k] = ~(uint64_t)0;
+	}
+
+	for (int y = 0; y < rows; y++)
+	{
+		const uint64_t* c = src + (size_t)y * stride;
+		const uint64_t* n = c - stride;
+		const uint64_t* s = c + stride;
+		uint64_t* out = dst + (size_t)y * stride;
+
+		for (size_t i = 0; i < words; i += batch)
+		{
+			size_t count = words - i < batch ? words - i : batch;
+
+			size_t k = 0;
+			for (; k + V::width <= count; k += V::width)
+			{
+				typename V::type planes[13];
+				neighbourhood_planes<V>(n + i + k, c + i + k, s + i + k, planes);
+				for (int p = 0; p < 13; p++) V::store(&inputs[p][k], planes[p]);
+			}
+			for (; k < count; k++)
+			{
+				uint64_t planes[13];
+				neighbourhood_planes<ScalarLane>(n + i + k, c + i + k, s + i + k, planes);
+				for (int p = 0; p < 13; p++) inputs[p][k] = planes[p];
+			}
+
+			for (size_t j = 0; j < diagram.size; j++)
+			{
+				const DecisionNode& node = diagram.nodes[j];
+				const uint64_t* select = inputs[node.variable];
+				const uint64_t* high = values[node.high];
+				const uint64_t* low = values[node.low];
+				for (k = 0; k < batch; k += V::width) V::store(&values[j + 2][k], choose<V>(V::load(select + k), V::load(high + k), V::load(low + k)));
+			}
+
+			const uint64_t* next = values[diagram.size + 1];
+			for (k = 0; k < count; k++) out[i + k] = next[k];
+		}
+	}
+}
+
+// Neighbours shifted onto the cell's own bit from the west and from the east, borrowing the edge bit from
+// the adjacent word
+template <class V>
+inline typename V::type from_west(const uint64_t* p) { return V::or_(V::shl(V::load(p), 1), V::shr(V::load(p - 1), 63)); }
+
+template <class V>
+inline typename V::type from_east(const uint64_t* p) { return V::or_(V::shr(V::load(p), 1), V::shl(V::load(p + 1), 63)); }
+
+// One lane-width of cells with 6 (hexagonal) or 4 (von Neumann) neighbours, summed with full adders into the
+// ones, twos and fours planes; eights stays clear. On hexagonal boards odd rows sit half a cell east of even
+// ones, so an even row's diagonal neighbours are the cells north-west and south-west of it, an odd row's the
+// cells north-east and south-east
+template <class V, Rule::Shape Shape, bool OddRow, class R>
+inline void evolve_lane_shaped(const uint64_t* n, const uint64_t* c, const uint64_t* s, uint64_t* out, const R& rule) {
+	typedef typename V::type T;
+
+	T n0 = V::load(n), c0 = V::load(c), s0 = V::load(s);
+	T w = from_west<V>(c), e = from_east<V>(c);
+
+	T ones, twos, fours;
+	if constexpr (Shape == Rule::Shape::hexagonal) {
+		T north = OddRow ? from_east<V>(n) : from_west<V>(n);
+		T south = OddRow ? from_east<V>(s) : from_west<V>(s);
+
+		T upper_sum = V::xor3(north, n0, w), upper_carry = V::maj(north, n0, w);
+		T lower_sum = V::xor3(south, s0, e), lower_carry = V::maj(south, s0, e);
+		ones = V::xor_(upper_sum, lower_sum);
+		T ones_carry = V::and_(upper_sum, lower_sum);
+		twos = V::xor3(upper_carry, lower_carry, ones_carry);
+		fours = V::maj(upper_carry, lower_carry, ones_carry);
+	}
+	else {
+		T sum = V::xor3(n0, s0, w), carry = V::maj(n0, s0, w);
+		ones = V::xor_(sum, e);
+		T ones_carry = V::and_(sum, e);
+		twos = V::xor_(carry, ones_carry);
+		fours = V::and_(carry, ones_carry);
+	}
+
+	V::store(out, rule.template apply<V>(c0, ones, twos, fours, V::broadcast(0)));
+}
+
+template <class V, Rule::Shape Shape, bool OddRow>
+inline void evolve_row_shaped(const uint64_t* n, const uint64_t* c, const uint64_t* s, uint64_t* out, size_t words, const DynamicRule& rule) {
+	size_t i = 0;
+	for (; i + V::width <= words; i += V::width) evolve_lane_shaped<V, Shape, OddRow>(n + i, c + i, s + i, out + i, rule);
+	for (; i < words; i++) evolve_lane_shaped<ScalarLane, Shape, OddRow>(n + i, c + i, s + i, out + i, rule);
+}
+
+// Hexagonal and von Neumann rules, through the generic rule whatever their counts; first_row tells the
+// parity of each row apart
+template <class V>
+void evolve_rows_shaped(const uint64_t* src, uint64_t* dst, size_t stride, size_t words, int rows, int first_row, const Rule& rule) {
+	DynamicRule policy(rule);
+
+	for (int y = 0; y < rows; y++)
+	{
+		const uint64_t* c = src + (size_t)y * stride;
+		const uint64_t* n = c - stride;
+		const uint64_t* s = c + stride;
+		uint64_t* out = dst + (size_t)y * stride;
+
+		if (rule.shape == Rule::Shape::von_neumann) evolve_row_shaped<V, Rule::Shape::von_neumann, false>(n, c, s, out, words, policy);
+		else if ((first_row + y) & 1) evolve_row_shaped<V, Rule::Shape::hexagonal, true>(n, c, s, out, words, policy);
+		else evolve_row_shaped<V, Rule::Shape::hexagonal, false>(n, c, s, out, words, policy);
+	}
+}
+
+// Picks the kernel specialized for the rule if it is one of the presets, the generic one otherwise, the
+// decision diagram for non-totalistic rules and the shaped kernels for the other neighbourhoods
+template <class V, size_t I = 0>
+void evolve_rows_rule(const uint64_t* src, uint64_t* dst, size_t stride, size_t words, int rows, int first_row, const Rule& rule) {
+	if constexpr (I == 0) {
+		if (rule.shape != Rule::Shape::moore) return evolve_rows_shaped<V>(src, dst, stride, words, rows, first_row, rule);
+		if (rule.non_totalistic()) return evolve_rows_isotropic<V>(src, dst, stride, words, rows, rule);
+	}
+
+	if constexpr (I < sizeof(preset_rules) / sizeof(preset_rules[0])) {
+		constexpr Rule preset = preset_rules[I].rule;
+		if (rule.birth == preset.birth && rule.survival == preset.survival) evolve_rows_lanes<V, StaticRule<preset.birth, preset.survival>>(src, dst, stride, words, rows, rule);
+		else evolve_rows_rule<V, I + 1>(src, dst, stride, words, rows, first_row, rule);
+	}
+	else evolve_rows_lanes<V, DynamicRule>(src, dst, stride, words, rows, rule);
+}
+
+// Generations step for one lane-width of cells: dying cells block births in next, live cells that did not
+// survive start dying, and dying cells age by one until they reach limit (the state count - 1) and are dead
+template <class V>
+inline void age_lane(const uint64_t* alive, uint64_t* next, uint64_t* ages, size_t plane_size, int planes, unsigned limit) {
+	typedef typename V::type T;
+
+	T age[8];
+	T dying = V::broadcast(0);
+	for (int p = 0; p < planes; p++)
+	{
+		age[p] = V::load(ages + p * plane_size);
+		dying = V::or_(dying, age[p]);
+	}
+
+	T born = V::andnot(dying, V::load(next));
+	T newly_dying = V::andnot(born, V::load(alive));
+	V::store(next, born);
+
+	// Bit-sliced increment of the dying cells' age, noting where it reaches the limit
+	T carry = dying, at_limit = V::broadcast(~(uint64_t)0);
+	for (int p = 0; p < planes; p++)
+	{
+		T sum = V::xor_(age[p], carry);
+		carry = V::and_(age[p], carry);
+		at_limit = ((limit >> p) & 1) ? V::and_(at_limit, sum) : V::andnot(sum, at_limit);
+		age[p] = sum;
+	}
+
+	for (int p = 0; p < planes; p++)
+	{
+		T value = V::andnot(at_limit, age[p]);
+		if (p == 0) value = V::or_(value, newly_dying);
+		V::store(ages + p * plane_size, value);
+	}
+}
+
+template <class V>
+void age_rows_lanes(const uint64_t* alive, uint64_t* next, uint64_t* ages, size_t plane_size, int planes, unsigned limit, size_t stride, size_t words, int rows) {
+	for (int y = 0; y < rows; y++)
+	{
+		size_t row = (size_t)y * stride;
+
+		size_t i = 0;
+		for (; i + V::width <= words; i += V::width) age_lane<V>(alive + row + i, next + row + i, ages + row + i, plane_size, planes, limit);
+		for (; i < words; i++) age_lane<ScalarLane>(alive + row + i, next + row + i, ages + row + i, plane_size, planes, limit);
+	}
+}
+
+}
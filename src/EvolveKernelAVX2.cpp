@@ -0,0 +1,51 @@
+#include "EvolveKernel.h"
+
+#ifdef CONGOL_X86
+
+#include <immintrin.h>
+
+// Compile this translation unit for AVX2 only; it is only entered after CPUID confirmed support
+#if defined(__clang__)
+#pragma clang attribute push (__attribute__((target("avx2"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC target("avx2")
+#endif
+
+#include "EvolveKernel.inl"
+
+namespace {
+
+struct Avx2Lane {
+	typedef __m256i type;
+	static constexpr size_t width = 4;
+
+	static constexpr bool ternary_logic = false;
+
+	static type broadcast(uint64_t v) { return _mm256_set1_epi64x((long long)v); }
+	static type load(const uint64_t* p) { return _mm256_loadu_si256((const __m256i*)p); }
+	static void store(uint64_t* p, type v) { _mm256_storeu_si256((__m256i*)p, v); }
+	static type or_(type a, type b) { return _mm256_or_si256(a, b); }
+	static type and_(type a, type b) { return _mm256_and_si256(a, b); }
+	static type xor_(type a, type b) { return _mm256_xor_si256(a, b); }
+	static type andnot(type a, type b) { return _mm256_andnot_si256(a, b); }
+	static type xor3(type a, type b, type c) { return _mm256_xor_si256(_mm256_xor_si256(a, b), c); }
+	static type maj(type a, type b, type c) { return _mm256_or_si256(_mm256_and_si256(a, b), _mm256_and_si256(c, _mm256_xor_si256(a, b))); }
+	static type shl(type v, int n) { return _mm256_slli_epi64(v, n); }
+	static type shr(type v, int n) { return _mm256_srli_epi64(v, n); }
+};
+
+}
+
+void evolve_rows_avx2(const uint64_t* src, uint64_t* dst, size_t stride, size_t words, int rows, int first_row, const Rule& rule) {
+	evolve_rows_rule<Avx2Lane>(src, dst, stride, words, rows, first_row, rule);
+}
+
+void age_rows_avx2(const uint64_t* alive, uint64_t* next, uint64_t* ages, size_t plane_size, int planes, unsigned limit, size_t stride, size_t words, int rows) {
+	age_rows_lanes<Avx2Lane>(alive, next, ages, plane_size, planes, limit, stride, words, rows);
+}
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#endif
+
+#endif
@@ -0,0 +1,155 @@
+#include "EvolveKernel.h"
+
+#ifdef CONGOL_X86
+
+#include <cstring>
+#include <immintrin.h>
+
+// Compile this translation unit for AVX-512F only; it is only entered after CPUID confirmed support
+#if defined(__clang__)
+#pragma clang attribute push (__attribute__((target("avx512f"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC target("avx512f")
+#endif
+
+#include "EvolveKernel.inl"
+
+namespace {
+
+struct Avx512Lane {
+	typedef __m512i type;
+	static constexpr size_t width = 8;
+
+	static constexpr bool ternary_logic = true;
+
+	static type broadcast(uint64_t v) { return _mm512_set1_epi64((long long)v); }
+	static type load(const uint64_t* p) { return _mm512_loadu_si512((const void*)p); }
+	static void store(uint64_t* p, type v) { _mm512_storeu_si512((void*)p, v); }
+	static type or_(type a, type b) { return _mm512_or_si512(a, b); }
+	static type and_(type a, type b) { return _mm512_and_si512(a, b); }
+	static type xor_(type a, type b) { return _mm512_xor_si512(a, b); }
+	static type andnot(type a, type b) { return _mm512_andnot_si512(a, b); }
+	// Three-input boolean functions in one instruction (0x96: a ^ b ^ c, 0xe8: majority)
+	static type xor3(type a, type b, type c) { return _mm512_ternarylogic_epi64(a, b, c, 0x96); }
+	static type maj(type a, type b, type c) { return _mm512_ternarylogic_epi64(a, b, c, 0xe8); }
+	static type shl(type v, int n) { return _mm512_slli_epi64(v, n); }
+	static type shr(type v, int n) { return _mm512_srli_epi64(v, n); }
+	// Any rule's truth table over (alive, twos, ones) is a single instruction too
+	template <unsigned Table>
+	static type ternary(type a, type b, type c) { return _mm512_ternarylogic_epi64(a, b, c, Table); }
+};
+
+}
+
+void evolve_rows_avx512(const uint64_t* src, uint64_t* dst, size_t stride, size_t words, int rows, int first_row, const Rule& rule) {
+	evolve_rows_rule<Avx512Lane>(src, dst, stride, words, rows, first_row, rule);
+}
+
+void age_rows_avx512(const uint64_t* alive, uint64_t* next, uint64_t* ages, size_t plane_size, int planes, unsigned limit, size_t stride, size_t words, int rows) {
+	age_rows_lanes<Avx512Lane>(alive, next, ages, plane_size, planes, limit, stride, words, rows);
+}
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#endif
+
+// The byte permutes below also need AVX512BW, AVX512VBMI and AVX512BITALG, checked separately at startup
+#if defined(__clang__)
+#pragma clang attribute push (__attribute__((target("avx512f,avx512bw,avx512vbmi,avx512bitalg"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC target("avx512bw,avx512vbmi,avx512bitalg")
+#endif
+
+namespace {
+
+// A row around word p[0]: lanes 0..5 hold the 64 cells from byte -1 of p[0] on, lanes 6 and 7 those from
+// byte 2, which covers the cells next to each lane's 8 cells (broadcasts are loads, leaving the shuffle port free)
+inline __m512i row_window(const uint64_t* p) {
+	uint64_t before, after;
+	std::memcpy(&before, (const char*)p - 1, sizeof(before));
+	std::memcpy(&after, (const char*)p + 2, sizeof(after));
+	return _mm512_mask_set1_epi64(_mm512_set1_epi64((long long)before), 0xc0, (long long)after);
+}
+
+// Cells i - 1..i + 1 of the row around p[0] in bits 0..2 of byte i
+inline __m512i row_cells(__m512i shifts, const uint64_t* p) {
+	return _mm512_multishift_epi64_epi8(shifts, row_window(p));
+}
+
+// Bytes from row_cells as vpshufbitqmb control, picking bit cells & 7 of byte i (0xec: cells & 7 | positions)
+inline __m512i bit_of(__m512i positions, __m512i cells) {
+	return _mm512_ternarylogic_epi64(cells, positions, _mm512_set1_epi8(0x07), 0xec);
+}
+
+// Byte constants of the gather kernel
+struct GatherBytes {
+	alignas(64) uint8_t shifts[64];		// Bit of each byte's lane window that cell i - 1 is at
+	alignas(64) uint8_t positions[64];	// First bit of each byte within its 64-bit lane
+
+	constexpr GatherBytes() : shifts(), positions() {
+		for (int k = 0; k < 64; k++)
+		{
+			shifts[k] = (uint8_t)(k < 48 ? k + 7 : k - 17);
+			positions[k] = (uint8_t)(8 * (k % 8));
+		}
+	}
+};
+
+constexpr GatherBytes gather_bytes;
+
+// Non-totalistic rules cell by cell. Multishift moves cells i - 1..i + 1 of a row into bits 0..2 of byte i,
+// and the resolved table is one 64-byte register: two rows side by side pick a byte of it and a third row
+// the bit within that byte. Rows y and y + 1 make one index for two cells, the one on row y (bit picked by
+// row y - 1) and the one on row y + 1 through the table with the south row first (bit picked by row
+// y + 2), so a word costs about as many instructions as counting its neighbours. Words are walked column by
+// column, each row's bytes made once for the three output rows around it
+void evolve_rows_gather(const uint64_t* src, uint64_t* dst, size_t stride, size_t words, int rows, const Rule& rule) {
+	constexpr int block = 64; // Rows per pass down a column, so that they stay in the cache for the next column
+
+	const uint64_t* tables = resolved_table(rule);
+	const __m512i table = _mm512_loadu_si512(tables), rotated = _mm512_loadu_si512(tables + 8);
+	const __m512i shifts = _mm512_load_si512(gather_bytes.shifts), positions = _mm512_load_si512(gather_bytes.positions);
+	const __m512i high_bits = _mm512_set1_epi8(0x38);
+
+	for (int first = 0; first < rows; first += block)
+	{
+		int last = first + block < rows ? first + block : rows;
+
+		for (size_t i = 0; i < words; i++)
+		{
+			const uint64_t* c = src + (size_t)first * stride + i;
+			uint64_t* out = dst + (size_t)first * stride + i;
+
+			__m512i north = bit_of(positions, row_cells(shifts, c - stride)), middle = row_cells(shifts, c);
+			for (int y = first; y < last; y += 2, c += 2 * stride, out += 2 * stride)
+			{
+				__m512i south = row_cells(shifts, c + stride);
+
+				// Table byte middle | south << 3 (0xac: bits 3..5 from south, the rest from middle; the shift spills
+				// bits across bytes only outside those)
+				__m512i index = _mm512_ternarylogic_epi64(high_bits, middle, _mm512_slli_epi64(south, 3), 0xac);
+				_store_mask64((__mmask64*)out, _mm512_bitshuffle_epi64_mask(_mm512_permutexvar_epi8(index, table), north));
+				if (y + 1 == last) break;
+
+				__m512i beyond = row_cells(shifts, c + 2 * stride);
+				_store_mask64((__mmask64*)(out + stride), _mm512_bitshuffle_epi64_mask(_mm512_permutexvar_epi8(index, rotated), bit_of(positions, beyond)));
+
+				north = bit_of(positions, south);
+				middle = beyond;
+			}
+		}
+	}
+}
+
+}
+
+void evolve_rows_avx512vbmi(const uint64_t* src, uint64_t* dst, size_t stride, size_t words, int rows, int first_row, const Rule& rule) {
+	if (rule.shape == Rule::Shape::moore && rule.non_totalistic()) evolve_rows_gather(src, dst, stride, words, rows, rule);
+	else evolve_rows_avx512(src, dst, stride, words, rows, first_row, rule);
+}
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#endif
+
+#endif
@@ -0,0 +1,115 @@
+#include "EvolveKernel.h"
+
+#include <memory>
+#include <mutex>
+
+// Block kernel in the manner of Golly's QuickLife: the board is read as 4x4 blocks, two rows and two columns
+// apart, and a 65536-entry table gives the next generation of each block's centre 2x2 cells. Everything is
+// plain integer arithmetic and one table load per four cells, for cores without wide vector units.
+
+namespace {
+
+struct BlockTable {
+	Rule rule;
+	bool odd_first_row;
+	uint8_t next[1 << 16];
+};
+
+// Next generation of the centre 2x2 cells, indexed by the block's four rows from the top (4 bits each, west to
+// east from the lowest bit); bits 0-1 are the upper row of the result and bits 4-5 the lower one, so that the
+// results of blocks a byte apart can be or'ed into one word. Hexagonal rules need a table per parity of the
+// upper row
+void fill_block_table(BlockTable& table) {
+	for (unsigned block = 0; block < (1 << 16); block++)
+	{
+		uint8_t next = 0;
+		for (int cy = 0; cy < 2; cy++)
+		{
+			for (int cx = 0; cx < 2; cx++)
+			{
+				unsigned neighbourhood = 0;
+				for (int dy = 0; dy < 3; dy++) neighbourhood |= ((block >> ((cy + dy) * 4 + cx)) & 7) << (dy * 3);
+				if (table.rule.next(neighbourhood, table.odd_first_row != (cy == 1))) next |= 1 << (cy * 4 + cx);
+			}
+		}
+		table.next[block] = next;
+	}
+}
+
+// Built on first use of a rule and kept for the rest of the run
+const uint8_t* block_table(const Rule& rule, bool odd_first_row) {
+	static std::mutex mutex;
+	static std::vector<std::unique_ptr<BlockTable>> tables;
+
+	std::lock_guard<std::mutex> lock(mutex);
+	for (const std::unique_ptr<BlockTable>& table : tables)
+	{
+		if (table->rule == rule && table->odd_first_row == odd_first_row) return table->next;
+	}
+
+	tables.push_back(std::make_unique<BlockTable>());
+	BlockTable& table = *tables.back();
+	table.rule = rule;
+	table.odd_first_row = odd_first_row;
+	fill_block_table(table);
+	return table.next;
+}
+
+}
+
+void evolve_rows_lut(const uint64_t* src, uint64_t* dst, size_t stride, size_t words, int rows, int first_row, const Rule& rule) {
+	const uint8_t* table = block_table(rule, first_row & 1);
+
+	for (int y = 0; y < rows; y += 2)
+	{
+		// The row below a lone last row may lie past the readable guard row; it only feeds the row that is not written
+		bool pair = y + 1 < rows;
+		const uint64_t* block_rows[4];
+		for (int r = 0; r < 4; r++) block_rows[r] = src + (ptrdiff_t)(y - 1 + (r == 3 && !pair ? 2 : r)) * (ptrdiff_t)stride;
+
+		uint64_t* upper_out = dst + (size_t)y * stride;
+		uint64_t* lower_out = upper_out + stride;
+
+		for (size_t i = 0; i < words; i++)
+		{
+			// Columns -1 to 62 of the word on bits 0 to 63, and columns 61 to 64 for the last block
+			uint64_t shifted[4];
+			unsigned last = 0;
+			for (int r = 0; r < 4; r++)
+			{
+				const uint64_t* row = block_rows[r];
+				shifted[r] = (row[i] << 1) | (row[i - 1] >> 63);
+				last |= (unsigned)((row[i] >> 61) | ((row[i + 1] & 1) << 3)) << (r * 4);
+			}
+
+			// Blocks a byte apart at a time: the nibbles of the four rows are interleaved into one 16-bit index
+			// per block, and the results land a byte apart too
+			uint64_t upper = 0, lower = 0;
+			for (int phase = 0; phase < 8; phase += 2)
+			{
+				uint64_t bytes[4];
+				for (int r = 0; r < 4; r++) bytes[r] = (shifted[r] >> phase) & 0x0f0f0f0f0f0f0f0full;
+				uint64_t top = bytes[0] | (bytes[1] << 4), bottom = bytes[2] | (bytes[3] << 4);
+				uint64_t even = (top & 0x00ff00ff00ff00ffull) | ((bottom & 0x00ff00ff00ff00ffull) << 8);
+				uint64_t odd = ((top >> 8) & 0x00ff00ff00ff00ffull) | (bottom & 0xff00ff00ff00ff00ull);
+
+				uint64_t next = 0;
+				for (int lane = 0; lane < 4; lane++)
+				{
+					next |= (uint64_t)table[(even >> (lane * 16)) & 0xffff] << (lane * 16);
+					next |= (uint64_t)table[(odd >> (lane * 16)) & 0xffff] << (lane * 16 + 8);
+				}
+				upper |= (next & 0x0303030303030303ull) << phase;
+				lower |= ((next >> 4) & 0x0303030303030303ull) << phase;
+			}
+
+			// The last block reaches into the next word
+			unsigned next = table[last];
+			upper = (upper & ~((uint64_t)3 << 62)) | (uint64_t)(next & 3) << 62;
+			lower = (lower & ~((uint64_t)3 << 62)) | (uint64_t)((next >> 4) & 3) << 62;
+
+			upper_out[i] = upper;
+			if (pair) lower_out[i] = lower;
+		}
+	}
+}
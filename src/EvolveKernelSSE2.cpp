@@ -0,0 +1,51 @@
+#include "EvolveKernel.h"
+
+#ifdef CONGOL_X86
+
+#include <immintrin.h>
+
+// Compile this translation unit for SSE2 only; it is only entered after CPUID confirmed support
+#if defined(__clang__)
+#pragma clang attribute push (__attribute__((target("sse2"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC target("sse2")
+#endif
+
+#include "EvolveKernel.inl"
+
+namespace {
+
+struct Sse2Lane {
+	typedef __m128i type;
+	static constexpr size_t width = 2;
+
+	static constexpr bool ternary_logic = false;
+
+	static type broadcast(uint64_t v) { return _mm_set1_epi64x((long long)v); }
+	static type load(const uint64_t* p) { return _mm_loadu_si128((const __m128i*)p); }
+	static void store(uint64_t* p, type v) { _mm_storeu_si128((__m128i*)p, v); }
+	static type or_(type a, type b) { return _mm_or_si128(a, b); }
+	static type and_(type a, type b) { return _mm_and_si128(a, b); }
+	static type xor_(type a, type b) { return _mm_xor_si128(a, b); }
+	static type andnot(type a, type b) { return _mm_andnot_si128(a, b); }
+	static type xor3(type a, type b, type c) { return _mm_xor_si128(_mm_xor_si128(a, b), c); }
+	static type maj(type a, type b, type c) { return _mm_or_si128(_mm_and_si128(a, b), _mm_and_si128(c, _mm_xor_si128(a, b))); }
+	static type shl(type v, int n) { return _mm_slli_epi64(v, n); }
+	static type shr(type v, int n) { return _mm_srli_epi64(v, n); }
+};
+
+}
+
+void evolve_rows_sse2(const uint64_t* src, uint64_t* dst, size_t stride, size_t words, int rows, int first_row, const Rule& rule) {
+	evolve_rows_rule<Sse2Lane>(src, dst, stride, words, rows, first_row, rule);
+}
+
+void age_rows_sse2(const uint64_t* alive, uint64_t* next, uint64_t* ages, size_t plane_size, int planes, unsigned limit, size_t stride, size_t words, int rows) {
+	age_rows_lanes<Sse2Lane>(alive, next, ages, plane_size, planes, limit, stride, words, rows);
+}
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#endif
+
+#endif
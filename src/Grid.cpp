@@ -1,6 +1,11 @@
+#include <algorithm>
 #include <cmath>
+#include <cstring>
+#include <map>
 #include "Grid.h"
 #include "Utils.h"
+#include "EvolveKernel.h"
+#include "ThreadPool.h"
 // Container
 Grid::Grid() {};
 
@@ -8,15 +13,18 @@ Grid::Grid() {};
 Grid::Grid(fan::window_t* window, fan::opengl::context_t* context, int subdivisions) {
 	rects_.open(context);
 	rects_.enable_draw(context);
+	hexes_.open(context);
 	this->context = context;
 	this->window = window;
 	this->init(subdivisions);
+	fan::print("Evolve kernel:", EvolveKernels::selected().name, "threads:", ThreadPool::shared().size());
 }
 
 // Initialize from save
 Grid::Grid(fan::window_t* window, fan::opengl::context_t* context, CellData cell_data) {
 	rects_.open(context);
 	rects_.enable_draw(context);
+	hexes_.open(context);
 	this->context = context;
 	this->window = window;
 	this->init(1);
@@ -35,6 +43,9 @@ void Grid::run() {
 
 	while (true) {
 
+		// A paused, settled board has nothing to show until something happens
+		if (idle_) window->wait_events();
+
 		uint32_t window_event = window->handle_events();
     if(window_event & fan::window_t::events::close){
       window->close();
@@ -43,12 +54,15 @@ void Grid::run() {
 
 		if (show_fps) window->get_fps();
 
-		if (paintingLive) set_alive_at_click();
+		if (paintingLive && (scrubbing_ || over_timeline())) scrub();
+		else if (paintingLive) set_alive_at_click();
 		if (paintingDead) set_dead_at_click();
+		if (scrubbing_ && !paintingLive) end_scrub();
 
 		// ugly, but works for now
 		if (count > tickrate && ticking_) {
-			evolve();
+			if (generations_per_tick_ > 1) fast_forward(generations_per_tick_);
+			else evolve();
 			count = 0;
 		}
 		else if (ticking_) count++;
@@ -63,10 +77,15 @@ void Grid::run() {
 
 std::vector<Grid::Cell> Grid::get_live_cells() {
 	std::vector<Cell> live_cells;
-	
-	for (int i = 0; i < cells_.size(); i++)
+	live_cells.reserve(cells_.population());
+
+	const BitGrid::Bounds& bounds = cells_.bounds();
+	for (int y = bounds.top; y < bounds.bottom; y++)
 	{
-		if (cells_[i].alive) live_cells.push_back(cells_[i]);
+		for (int x = bounds.left; x < bounds.right; x++)
+		{
+			if (cells_.get(x, y)) live_cells.push_back(Cell(true, y * cells_.width() + x));
+		}
 	}
 
 	return live_cells;
@@ -87,17 +106,21 @@ void Grid::init(int subdivisions) {
 	if (window != NULL)
 	{
 		// Clean previous data, whether it exists or not
-		this->cells_.clear();
 		this->map_.clear();
 
 		// Determine size of a single cell
 		this->cell_size_ = fan::cast<float>(window->get_size()) / subdivisions;
 
 		// Fill current grid with dead cells
-		for (size_t i = 0; i < ((long long int)subdivisions * subdivisions); i++)
-		{
-			this->cells_.push_back(Cell(false, cells_.size()));
+		Topology topology = cells_.topology();
+		this->cells_ = BitGrid(subdivisions, subdivisions);
+		if (!topology_fits(rule_, topology)) {
+			fan::print("Hexagonal rules need a plane or a torus of even height");
+			topology = Topology::plane;
 		}
+		this->cells_.set_topology(topology);
+		this->cells_.set_rule(rule_);
+		reset_cycle();
 
 		// Offset drawing points by cell size
 		fan::vec2 offset(cell_size_.x, cell_size_.y);
@@ -126,20 +149,38 @@ void Grid::init(int subdivisions) {
 	p.size = (cell_size_ * 0.875) / 2;
 	p.color = color_dead_;
 	cursor_rects_.push_back(context, p); // selection highlight filler (completes illusion of outline)
+
+	// Laid out when shown
+	timeline_rects_.open(context);
+	p.size = 0;
+	p.color = fan::colors::gray;
+	timeline_rects_.push_back(context, p); // track
+	p.color = fan::colors::cyan;
+	timeline_rects_.push_back(context, p); // thumb
 }
 
 void Grid::import(CellData cell_data) {
-	this->cells_.clear();
 	this->map_.clear();
 
 	this->cells_ = cell_data.cells_;
+	this->plane_ = cell_data.plane_;
 	this->map_ = cell_data.map_;
 	this->cell_size_ = cell_data.cell_size_;
+
+	restored();
+}
+
+void Grid::restored() {
+	// History keeps cells, not settings
+	this->cells_.set_rule(rule_);
+	this->plane_.set_rule(rule_);
+	update_view();
+	reset_cycle();
 }
 
 void Grid::import(int i) {
-	if (history_.size() >= i) { 
-		this->import(history_[i]); 
+	if (i >= 0 && history_.get(i, cells_, plane_)) {
+		restored();
 		slot_ = i;
 		fan::print("Current slot:", slot_);
 		fan::print("History size:", history_.size());
@@ -148,6 +189,7 @@ void Grid::import(int i) {
 
 void Grid::toggle_simulation() {
 	ticking_ = !ticking_;
+	idle_ = false;
 }
 
 Grid::cellvec2 Grid::cv_to_cv2D(cellvec& cv) {
@@ -194,112 +236,463 @@ Grid::cellvec Grid::cv2D_to_cv(cellvec2& cv2) {
 }
 
 
-// Apply the game rules & necessary corrections upon boundary overlaps (side overlap
-void Grid::evolve() {
-	// unimplemented
-	//cellvec2 cells2D_ = cv_to_cv2D(this->cells_); // convert cells from 1D to 2D
-	// unimplemented ^^^^^^
+void Grid::save_slot() {
+	history_.truncate(slot_);
+	slot_++;
+	history_.push(cells_, plane_, replayable_ ? generation_ - saved_generation_ : 0, unbounded_);
+	saved_generation_ = generation_;
+	replayable_ = !larger_than_life_;
+}
 
-	std::vector<Cell> live_cells = get_live_cells();
+void Grid::update_view() {
+	if (unbounded_) plane_.view(cells_, origin_.x, origin_.y);
+}
 
-	// Save current state
-	slot_++;
-	history_.push_back(CellData(this->cells_, this->map_, this->cell_size_));
+// Apply the game rules; cells beyond the edges of the grid count as dead unless the plane is unbounded
+void Grid::evolve() {
+	save_slot();
 	fan::print("Evolved   to slot: ", slot_);
-	//
 
-	std::vector<int> live_indices;
-	std::vector<int> kill_indices; // is there a better, in this case, more readable solution?
+	if (unbounded_) {
+		plane_.evolve();
+		update_view();
+	}
+	else if (larger_than_life_) ltl_.evolve(cells_);
+	else cells_.evolve();
 
-	
+	observe_cycle(1);
+}
 
-	for (int i = 0; i < live_cells.size(); i++)
-	{
-		// Any live cell with fewer than two live neighbours dies, as if by underpopulation
-		if (get_live_cells(live_cells[i].perimeter(*(this))).size() < 2) kill_indices.push_back(live_cells[i].index);
+void Grid::fast_forward(uint64_t generations) {
+	save_slot();
 
-		// Any live cell with two or three live neighbours lives on to the next generation
-		if (get_live_cells(live_cells[i].perimeter(*(this))).size() == 2 || get_live_cells(live_cells[i].perimeter(*(this))).size() == 3) live_indices.push_back(live_cells[i].index);
+	// The board is looked up after every step; once it is known to repeat, whole periods are skipped.
+	// The bounded board steps in blocks, which only reveals a multiple of the period
+	uint64_t remaining = generations;
+	while (remaining > 0) {
+		uint64_t step = 1;
+		if (unbounded_) plane_.evolve();
+		else if (larger_than_life_) ltl_.evolve(cells_);
+		else {
+			step = std::min<uint64_t>(remaining, BitGrid::max_block_generations);
+			cells_.evolve_n((int)step);
+		}
+		remaining -= step;
+
+		uint64_t period = observe_cycle(step);
+		if (period != 0 && remaining >= period) {
+			generation_ += remaining - remaining % period;
+			remaining %= period;
+			// The history can't recompute the skipped periods one generation at a time
+			replayable_ = false;
+		}
+	}
+	update_view();
+	fan::print("Forwarded to slot: ", slot_, "(", generations, "generations )");
+}
+
+uint64_t Grid::observe_cycle(uint64_t generations) {
+	generation_ += generations;
+	uint64_t period = cycles_.observe(board_hash(), generation_);
 
-		// Any live cell with more than three live neighbours dies, as if by overpopulation
-		if (get_live_cells(live_cells[i].perimeter(*(this))).size() > 3) kill_indices.push_back(live_cells[i].index);
+	if (period != 0 && period != reported_period_) {
+		if (cycles_.exact()) fan::print("Cycle detected: period", period);
+		else fan::print("Cycle detected: repeats every", period, "generations");
+		reported_period_ = period;
+	}
 
-		// Any dead cell with exactly three live neighbours becomes a live cell, as if by reproduction (not added to queue as release moment doesn't matter for last one)
-		std::vector<Cell> cell_perimeter = live_cells[i].perimeter(*(this)); // get perimeter of i (live_cell)
-		for (int i = 0; i < cell_perimeter.size(); i++)
+	// A multiple of the period within the limit means the period is too
+	if (period != 0 && period <= settle_period_ && !settled_) {
+		settled_ = true;
+		fan::print("Settled at generation", generation_);
+		if (on_settled_) on_settled_(period);
+		if (pause_when_settled_ && ticking_) {
+			ticking_ = false;
+			idle_ = true;
+		}
+	}
+	return period;
+}
+
+void Grid::reset_cycle() {
+	generation_ = 0;
+	cycles_.clear();
+	reported_period_ = 0;
+	settled_ = idle_ = false;
+	replayable_ = false;
+}
+
+void Grid::leap() {
+	// HashLife evolves an infinite plane, which only the unbounded mode is: cells leaving the bounded board
+	// would come back as if they had never died. Hexagonal rules depend on row parity, which memoized nodes
+	// know nothing about. Step those instead, no further than the render thread can afford to wait for
+	if (!unbounded_ || rule_.shape == Rule::Shape::hexagonal) {
+		int exponent = std::min(leap_exponent_, max_stepped_leap_exponent);
+		if (exponent < leap_exponent_) fan::print("Leaps are stepped here, so at most 2 ^", exponent, "generations");
+		fast_forward((uint64_t)1 << exponent);
+		return;
+	}
+
+	save_slot();
+
+	hashlife_.import(plane_);
+	hashlife_.advance(leap_exponent_);
+	hashlife_.export_to(plane_);
+	update_view();
+	observe_cycle((uint64_t)1 << leap_exponent_);
+	// Recomputing the leap one generation at a time would take as long as it skipped
+	replayable_ = false;
+
+	fan::print("Leaped    to slot: ", slot_, "(", (uint64_t)1 << leap_exponent_, "generations,", hashlife_.node_count(), "nodes,", hashlife_.memo_hit_rate() * 100, "% memo hits )");
+}
+
+void Grid::set_unbounded(bool unbounded) {
+	if (unbounded == unbounded_) return;
+	if (unbounded && (rule_.needs_bounded_board() || larger_than_life_)) {
+		fan::print("The rule needs a bounded board");
+		return;
+	}
+	unbounded_ = unbounded;
+	reset_cycle();
+
+	// The pattern carries over through the window
+	plane_.clear();
+	if (unbounded_) {
+		for (int y = 0; y < cells_.height(); y++)
 		{
-			// Takes perimeters of perimeter cells
-			if (get_live_cells(cell_perimeter[i].perimeter(*(this))).size() == 3)
+			for (int x = 0; x < cells_.width(); x++)
 			{
-				live_indices.push_back(cell_perimeter[i].index);
+				if (cells_.get(x, y)) plane_.set(origin_.x + x, origin_.y + y, true);
 			}
 		}
 	}
+	fan::print(unbounded_ ? "Unbounded plane" : "Bounded board");
+}
+
+void Grid::set_topology(Topology topology) {
+	const char* names[] = { "plane", "torus", "Klein bottle" };
+
+	if (!topology_fits(rule_, topology)) {
+		fan::print("Hexagonal rules need a plane or a torus of even height");
+		return;
+	}
+
+	cells_.set_topology(topology);
+	reset_cycle();
+	fan::print("Topology:", names[(int)topology]);
+}
+
+bool Grid::set_rule(const std::string& rulestring) {
+	Rule rule;
+	LtlRule ltl_rule;
+	bool outer_totalistic = Rule::parse(rulestring, rule);
+	if (!outer_totalistic && !LtlRule::parse(rulestring, ltl_rule)) {
+		fan::print("Invalid rule:", rulestring);
+		return false;
+	}
+	if (unbounded_ && (!outer_totalistic || rule.needs_bounded_board())) {
+		fan::print("The rule needs a bounded board");
+		return false;
+	}
+
+	if (!outer_totalistic) {
+		set_rule(ltl_rule);
+		return true;
+	}
+	return set_rule(rule);
+}
+
+void Grid::set_rule(const LtlRule& rule) {
+	ltl_.set_rule(rule);
+	larger_than_life_ = true;
+
+	// The other engines stay two-state while Larger than Life runs
+	rule_ = Rule();
+	cells_.set_rule(rule_);
+	plane_.set_rule(rule_);
+	reset_cycle();
+	update_palette();
+	set_hexagonal_cells(false);
+
+	std::string name;
+	for (const NamedLtlRule& preset : preset_ltl_rules)
+	{
+		LtlRule preset_rule;
+		if (LtlRule::parse(preset.rule, preset_rule) && preset_rule == rule) name = preset.name;
+	}
+	fan::print("Rule:", rule.to_string(), name);
+}
+
+bool Grid::set_rule(const Rule& rule) {
+	if (!topology_fits(rule, cells_.topology())) {
+		fan::print("Hexagonal rules need a plane or a torus of even height");
+		return false;
+	}
 
-	// release KillIndices
-	for (int i = 0; i < kill_indices.size(); i++)
+	larger_than_life_ = false;
+	rule_ = rule;
+	cells_.set_rule(rule);
+	plane_.set_rule(rule);
+	hashlife_.set_rule(rule);
+	reset_cycle();
+	update_palette();
+	set_hexagonal_cells(rule.shape == Rule::Shape::hexagonal);
+
+	std::string name;
+	for (const NamedRule& preset : preset_rules)
 	{
-		cells_[kill_indices[i]].alive = false;
+		if (preset.rule == rule) name = preset.name;
+	}
+	fan::print("Rule:", rule.to_string(), name);
+	return true;
+}
+
+bool Grid::topology_fits(const Rule& rule, Topology topology) const {
+	if (rule.shape != Rule::Shape::hexagonal || topology == Topology::plane) return true;
+	return topology == Topology::torus && cells_.height() % 2 == 0;
+}
+
+void Grid::set_hexagonal_cells(bool hexagonal) {
+	if (hexagonal == hexagonal_cells_) return;
+
+	cell_shapes().disable_draw(context);
+	cell_shapes().clear(context);
+	hexagonal_cells_ = hexagonal;
+	cell_shapes().enable_draw(context);
+	reset_cell_shapes();
+
+	// Keep the timeline drawn over the cells
+	if (timeline_shown_) {
+		timeline_rects_.disable_draw(context);
+		timeline_rects_.enable_draw(context);
 	}
+}
+
+void Grid::reset_cell_shapes() {
+	cell_shapes().clear(context);
+	repaint();
+}
+
+fan::vec2 Grid::cell_position(uint32_t i) const {
+	if (!hexagonal_cells_) return map_[i];
+
+	// Rows keep their parity on the plane, so the window shifts the same rows as the plane does
+	int y = (int)(i / cells_.width()) + (unbounded_ ? origin_.y : 0);
+	return map_[i] + fan::vec2((y & 1) ? cell_size_.x / 2 : 0, 0);
+}
+
+void Grid::repaint() {
+	std::fill(drawn_.begin(), drawn_.end(), no_state);
+	drawn_bounds_ = { 0, 0, cells_.width(), cells_.height() };
+}
+
+Grid::Stats Grid::stats() const {
+	return { generation_, unbounded_ ? plane_.population() : cells_.population(), cells_.bounds(), reported_period_, settled_,
+		history_.size() - history_.first(), history_.stored(), history_.bytes(), history_.disk_bytes() };
+}
 
-	// release LiveIndices
-	for (int i = 0; i < live_indices.size(); i++)
+void Grid::print_census() {
+	// The census steps the phases of the ash with the board's own rule, which Larger than Life replaces
+	if (larger_than_life_) {
+		fan::print("The census only takes apart boards under B/S rules");
+		return;
+	}
+	if (reported_period_ == 0) {
+		fan::print("The board has not started repeating yet");
+		return;
+	}
+
+	std::map<std::string, uint64_t> counts;
+	for (const std::string& code : census_.objects(cells_, reported_period_)) counts[code]++;
+	if (counts.empty()) fan::print("No objects (or a period over", Census::max_period, ")");
+	for (const auto& [code, count] : counts) fan::print(code, count);
+}
+
+void Grid::update_palette() {
+	palette_.assign(rule_.states, color_dead_);
+	palette_[1] = color_alive_;
+
+	for (int state = 2; state < rule_.states; state++)
 	{
-		cells_[live_indices[i]].alive = true;
+		float fade = (float)(state - 1) / (rule_.states - 1);
+		palette_[state] = color_alive_ * (0.75f * (1 - fade)) + color_dead_ * fade;
+		palette_[state].a = 1;
 	}
+	repaint();
+}
+
+void Grid::pan(int dx, int dy) {
+	if (!unbounded_) return;
+
+	origin_ += fan::vec2i(dx, dy);
+	if (hexagonal_cells_ && (dy & 1)) reset_cell_shapes();
+	update_view();
 }
 
 void Grid::devolve() {
-	if (slot_ != 0) {
+	// From an earlier slot, the ones after it go first
+	history_.truncate(slot_);
+	if (slot_ != 0 && !history_.empty()) {
 		--slot_;
-		import(history_[slot_]);
-		history_.pop_back();
+		history_.pop(cells_, plane_);
+		restored();
 		fan::print("Devolved  to slot: ", slot_);
 	}
 }
 
+void Grid::toggle_timeline() {
+	timeline_shown_ = !timeline_shown_;
+	if (timeline_shown_) timeline_rects_.enable_draw(context);
+	else timeline_rects_.disable_draw(context);
+}
+
+void Grid::scrub() {
+	if (history_.empty() && slot_ != history_.size()) return;
+	if (!scrubbing_) {
+		scrubbing_ = true;
+		ticking_ = false;
+		idle_ = false;
+		scrub_slot_ = slot_;
+	}
+
+	fan::vec2 size = fan::cast<float>(window->get_size());
+	uint64_t first = history_.first(), last = last_slot();
+	float at = std::clamp(window->get_mouse_position().x / size.x, 0.0f, 1.0f);
+	uint64_t slot = first + (uint64_t)std::llround(at * (last - first));
+	if (slot == scrub_slot_) return;
+	scrub_slot_ = slot;
+
+	// The live board is saved first, so that it can be scrubbed back to. Only stored states are shown while
+	// dragging, each a few deltas away from the one before, so a frame stays cheap however far the pointer moves
+	if (slot_ == history_.size()) save_slot();
+	if (!history_.seek(slot, cells_, plane_)) return;
+	slot_ = (uint32_t)slot;
+	restored();
+}
+
+void Grid::end_scrub() {
+	scrubbing_ = false;
+	if (scrub_slot_ != slot_) import((int)scrub_slot_);
+}
+
+void Grid::update_timeline() {
+	if (!timeline_shown_) return;
+
+	fan::vec2 size = fan::cast<float>(window->get_size());
+	uint64_t first = history_.first(), last = last_slot();
+	float at = last > first ? (float)((scrubbing_ ? scrub_slot_ : slot_) - first) / (last - first) : 1;
+
+	timeline_rects_.set_position(context, 0, fan::vec2(size.x / 2, size.y - timeline_height / 2));
+	timeline_rects_.set_size(context, 0, fan::vec2(size.x / 2, timeline_height / 2));
+	timeline_rects_.set_position(context, 1, fan::vec2(at * size.x, size.y - timeline_height / 2));
+	timeline_rects_.set_size(context, 1, fan::vec2(timeline_height / 4, timeline_height / 2));
+}
+
 uint32_t Grid::translate_mouse_to_gridmap() {  // could use a better; shorter name without sacrificing readability
-	fan::vec2i cell_origin = (window->get_mouse_position() / cell_size_).floor();
+	fan::vec2 mouse = window->get_mouse_position();
+	fan::vec2i cell_origin = (mouse / cell_size_).floor();
+
+	if (hexagonal_cells_) {
+		// Nearest centre among the rows around the pointer, with rows squeezed back to a regular hexagon's
+		// spacing (the vertical scale makes the hexagon's width sqrt(3) / 2 of its height)
+		const float squeeze = cell_size_.x * 2 / std::sqrt(3.0f) / (cell_size_.y * 4 / 3);
+		float best = INFINITY;
+		fan::vec2i nearest = cell_origin;
+		for (int y = cell_origin.y - 1; y <= cell_origin.y + 1; y++)
+		{
+			if (y < 0 || y >= cells_.height()) continue;
+			float shift = ((y + (unbounded_ ? origin_.y : 0)) & 1) ? 0.5f : 0;
+			int x = std::clamp((int)std::floor(mouse.x / cell_size_.x - shift), 0, cells_.width() - 1);
+
+			fan::vec2 offset = cell_position(y * cells_.width() + x) - mouse;
+			float distance = offset.x * offset.x + offset.y * offset.y * squeeze * squeeze;
+			if (distance < best) {
+				best = distance;
+				nearest = fan::vec2i(x, y);
+			}
+		}
+		cell_origin = nearest;
+	}
 
 	uint32_t index = cell_origin.y * get_window_divisor() + cell_origin.x;
 
-	return fan::clamp(index, (uint32_t)0, (uint32_t)cells_.size() - 1); // clamp index between boundaries & return
+	return fan::clamp(index, (uint32_t)0, (uint32_t)(cells_.width() * cells_.height()) - 1); // clamp index between boundaries & return
 }
 
 void Grid::set_alive_at_click() {
 	int i = translate_mouse_to_gridmap();
-	cells_[i].alive = true;
-	rects_.set_color(context, 1, color_alive_); // a confusing line - updates the highlight filler to match the new state ... refactor away
+	uint64_t hash = board_hash();
+	cells_.set(i % get_window_divisor(), i / get_window_divisor(), true);
+	if (unbounded_) plane_.set(origin_.x + i % get_window_divisor(), origin_.y + i / get_window_divisor(), true);
+	if (board_hash() != hash) reset_cycle();
 	update_cursor_highlight();
 }
 
 void Grid::set_dead_at_click() {
 	int i = translate_mouse_to_gridmap();
-	cells_[i].alive = false;
-	rects_.set_color(context, 1, color_dead_); // a confusing line - updates the highlight filler to match the new state ... refactor away
+	uint64_t hash = board_hash();
+	cells_.set(i % get_window_divisor(), i / get_window_divisor(), false);
+	if (unbounded_) plane_.set(origin_.x + i % get_window_divisor(), origin_.y + i / get_window_divisor(), false);
+	if (board_hash() != hash) reset_cycle();
 	update_cursor_highlight();
 }
 
 // Draw based on object data
 void Grid::draw() {
-	// Initialize grid_ for drawing if uninitialized 
-	if (rects_.size(context) == 0) { 
-		for (int i = 0; i < cells_.size(); i++)
+	fan_2d::graphics::rectangle_t& shapes = cell_shapes();
+
+	// Initialize grid_ for drawing if uninitialized; hexagons are a third taller than a row so that the pointed
+	// ends of the offset rows interlock
+	if (shapes.size(context) == 0) { 
+		for (int i = 0; i < map_.size(); i++)
 		{
 			fan_2d::graphics::rectangle_t::properties_t p;
-			p.position = map_[i] - p.size;
-			p.size = cell_size_ / 2;
+			p.position = cell_position(i);
+			p.size = hexagonal_cells_ ? fan::vec2(cell_size_.x / 2, cell_size_.y * 2 / 3) : cell_size_ / 2;
 			p.color = color_dead_;
-			rects_.push_back(context, p);
+			shapes.push_back(context, p);
 		}
+		repaint();
 	}
 
-	// Determine and set cell color (alive? dead?)
-	for (int i = 0; i < cells_.size(); i++)
+	if (drawn_.size() != map_.size()) {
+		drawn_.resize(map_.size());
+		repaint();
+	}
+	if (palette_.size() != rule_.states) update_palette();
+
+	// Recolour only the cells whose state changed since the last frame, writing the palette colour straight
+	// into the vertex buffer and uploading the edited range once
+	const uint32_t vertex_count = shapes.vertex_count, element_size = shapes.element_byte_size;
+	uint8_t* vertices = shapes.m_glsl_buffer.m_buffer.begin();
+	uint32_t first = UINT32_MAX, last = 0;
+
+	// Cells drawn alive or dying last frame, and those that are now
+	const BitGrid::Bounds& bounds = cells_.bounds();
+	BitGrid::Bounds scan = drawn_bounds_;
+	if (scan.empty()) scan = bounds;
+	else if (!bounds.empty()) scan = { std::min(scan.left, bounds.left), std::min(scan.top, bounds.top), std::max(scan.right, bounds.right), std::max(scan.bottom, bounds.bottom) };
+	drawn_bounds_ = bounds;
+
+	row_states_.resize(cells_.width());
+	for (int y = scan.top; y < scan.bottom; y++)
 	{
-		if (cells_[i].alive) { rects_.set_color(context, i, color_alive_); }
-		else { rects_.set_color(context, i, color_dead_); };// If cell is alive, color - else, leave black (dead)
+		cells_.row_states(y, row_states_.data());
+		for (int x = scan.left; x < scan.right; x++)
+		{
+			uint32_t i = y * cells_.width() + x;
+			if (drawn_[i] == row_states_[x]) continue;
+
+			drawn_[i] = row_states_[x];
+			const fan::color& color = palette_[row_states_[x]];
+			for (uint32_t v = 0; v < vertex_count; v++) std::memcpy(vertices + (i * vertex_count + v) * element_size + shapes.offset_color, &color, sizeof(color));
+
+			first = std::min(first, i);
+			last = i;
+		}
 	}
+	if (first <= last) shapes.m_queue_helper.edit(context, first * vertex_count * element_size, (last + 1) * vertex_count * element_size, &shapes.m_glsl_buffer);
 
 	update_cursor_highlight();
+	update_timeline();
 }
\ No newline at end of file
@@ -1,8 +1,15 @@
 #pragma once
 
 #include <fan/graphics/gui.h>
+#include <functional>
 #include <vector>
-#include "Grid.h"
+#include "BitGrid.h"
+#include "Census.h"
+#include "CycleDetector.h"
+#include "HashLife.h"
+#include "History.h"
+#include "LargerThanLife.h"
+#include "TileMap.h"
 
 class Grid
 {
@@ -15,131 +22,27 @@ private:
 			this->alive = alive;
 			this->index = index;
 		}
-
-		// Returns indices (8) around a cell (top to bottom)
-		std::vector<Cell> perimeter(Grid& grid) {
-			int i = index;
-
-			// lazy solution, but scalable - definitely in need of a better one
-			std::vector<Cell> perimeter;
-			int vertical_increment = std::sqrt(grid.cells_.size());
-
-			
-			i = i - vertical_increment - 1;
-			if (i == (0 - vertical_increment - 1)) {
-				perimeter.push_back(grid.cells_.back());
-			}
-			else if (i == (0 - vertical_increment)) {
-				perimeter.push_back(grid.cells_[Corners(grid).LowerLeft]);
-			}
-			else if (i == (0 - vertical_increment + 1)) {
-
-			}
-			else perimeter.push_back(grid.cells_[i]);
-
-			i++;
-			perimeter.push_back(grid.cells_[i]);
-
-			i++;
-			perimeter.push_back(grid.cells_[i]);
-
-			i = i + vertical_increment - 2;
-			perimeter.push_back(grid.cells_[i]);
-
-			/*i++;							// the cell itself
-			perimeter.push_back(i);*/
-
-			i = i + 2;
-			perimeter.push_back(grid.cells_[i]);
-
-			i = i + vertical_increment - 2;
-			perimeter.push_back(grid.cells_[i]);
-
-			i++;
-			perimeter.push_back(grid.cells_[i]);
-
-			i++;
-			perimeter.push_back(grid.cells_[i]);
-
-			return perimeter;
-		}
-	};
-
-	struct Corners {
-		int UpperLeft;
-		int UpperRight;
-		int LowerLeft;
-		int LowerRight;
-
-		Corners(Grid grid)
-			:
-			UpperLeft(0), 
-			UpperRight(std::sqrt(grid.cells_.size()) - 1), 
-			LowerLeft(std::sqrt(grid.cells_.size()) * (std::sqrt(grid.cells_.size()) - 1)),
-			LowerRight(grid.cells_.size() - 1) {}
-
-		Corners(int UpperLeft, int UpperRight, int LowerLeft, int LowerRight) {
-			this->UpperLeft = UpperLeft;
-			this->UpperRight = UpperRight;
-			this->LowerLeft = LowerLeft;
-			this->LowerRight = LowerRight;
-		}
-	};
-
-	struct Sides {
-		// Horizontal sides
-		std::vector<Cell> ab;
-		std::vector<Cell> cd;
-
-		// Vertical sides
-		std::vector<Cell> ac;
-		std::vector<Cell> bd;
-
-		Sides(Grid& grid)
-		{
-			int sidelength = grid.get_window_divisor();
-
-			for (int a_1 = Corners(grid).UpperLeft, c = Corners(grid).LowerLeft, a_2 = Corners(grid).UpperLeft, b = Corners(grid).UpperRight; a_1 < sidelength; a_1++, c++, a_2 += sidelength, b += sidelength)
-			{
-				//		a _ b			
-				//		 |_|			
-				//		c   d	
-
-				// side ab (move from left to right with increments of 1, starting from point a)
-				ab.push_back(grid.cells_[a_1]);
-
-				// side cd (move from left to right with increments of 1, starting from point c)
-				cd.push_back(grid.cells_[c]);
-
-				// side ac (fall starting from point a with vertical_increment, starting from point a)
-				ac.push_back(grid.cells_[a_2]);
-
-				// side bd (fall starting from point b with vertical_increment, starting from point a)
-				bd.push_back(grid.cells_[b]);
-			}
-		}
-
-		bool CorrectOverlaps(std::vector<Cell>& cells, Corners& corners) {
-			//std::vector<Cell> side_cells = FindSides(cells, corners);
-		}
 	};
 
 	struct CellData {
-		std::vector<Cell> cells_;
+		BitGrid cells_;
+		TileMap plane_; // Whole pattern in unbounded mode, empty otherwise
 		std::vector<fan::vec2> map_;
 		fan::vec2 cell_size_;
 		
 		CellData() {}
-		CellData(std::vector<Cell> cells, std::vector<fan::vec2> map, fan::vec2 cell_size) {
+		CellData(BitGrid cells, TileMap plane, std::vector<fan::vec2> map, fan::vec2 cell_size) {
 			cells_ = cells;
+			plane_ = plane;
 			map_ = map;
 			cell_size_ = cell_size;
 		}
 
 		CellData(Grid* grid) {
 			cells_ = grid->cells_;
+			plane_ = grid->plane_;
 			map_ = grid->map_;
-			cell_size_ = fan::cast<float>(window->get_size()) / sqrt(cells_.size());
+			cell_size_ = fan::cast<float>(window->get_size()) / cells_.width();
 		}
 	};
 
@@ -153,7 +56,18 @@ private:
 	//inline static fan_2d::graphics::gui::text_renderer* text_;
 	
 	fan_2d::graphics::rectangle_t rects_;
+	fan_2d::graphics::hexagon_t hexes_; // Drawn instead of rects_ under a hexagonal rule
 	fan_2d::graphics::rectangle_t cursor_rects_;
+	bool hexagonal_cells_ = false;
+
+	// Timeline of the history along the bottom of the window: the track, then the thumb at the current slot.
+	// Dragging it previews the nearest stored slot under the pointer (scrub_slot_) and settles on the exact
+	// one when let go
+	static constexpr float timeline_height = 16;
+	fan_2d::graphics::rectangle_t timeline_rects_;
+	bool timeline_shown_ = false;
+	bool scrubbing_ = false;
+	uint64_t scrub_slot_ = 0;
 
 	
 
@@ -162,14 +76,118 @@ private:
 
 	const int horizontal_increment_ = 1;
 
-	// Stores each generation of cells, or more generally, each movement
-	std::vector<CellData> history_;
+	// Stores each generation of cells, or more generally, each movement, as deltas between keyframes
+	History history_;
+
+	// generation_ when the last slot was saved, and whether the board has only been stepped since, so that
+	// the history may recompute the next slot from it (not after an edit, a leap, skipped periods or Larger
+	// than Life)
+	uint64_t saved_generation_ = 0;
+	bool replayable_ = false;
 	std::vector<fan::vec2> map_; // Grid coordinates of each cell (for graphical representation of cells)
-	std::vector<Cell> cells_;	// Stores cell data
+	BitGrid cells_;	// Stores cell data, 64 cells per word
 	fan::vec2 cell_size_;
 
+	// Unbounded mode: the plane holds the pattern and cells_ is the window onto it, top left at origin_
+	bool unbounded_ = false;
+	TileMap plane_;
+	fan::vec2i origin_ = 0;
+
+	// Generations evolved since the board was last set up or edited, and the hashes of the recent ones, to
+	// notice when the board starts repeating itself
+	uint64_t generation_ = 0;
+	CycleDetector cycles_;
+	uint64_t reported_period_ = 0;
+
+	// Whether the board has settled since it was last set up or edited, and whether that paused the
+	// simulation (the main loop then sleeps until a window event)
+	bool settled_ = false;
+	bool idle_ = false;
+
+	// Names the objects of the board once it repeats; keeps its cache of shapes between calls
+	Census census_;
+
+	// Quadtree engine for leaping far ahead; kept alive between leaps so its memoized results carry over
+	HashLife hashlife_;
+
+	// Rule every engine evolves under, unless a Larger than Life rule replaces it on the bounded board
+	Rule rule_;
+	LargerThanLife ltl_;
+	bool larger_than_life_ = false;
+
+	// Colour of each cell state (dead, alive, then the dying states of a Generations rule), and the state
+	// each rectangle was last coloured with (no_state forces a repaint)
+	static constexpr uint16_t no_state = 0xffff;
+	std::vector<fan::color> palette_;
+	std::vector<uint16_t> drawn_;
+	std::vector<uint8_t> row_states_;
+
+	// Every cell outside drawn_bounds_ was last coloured dead, so a frame only needs to look inside it and
+	// the board's current bounds
+	BitGrid::Bounds drawn_bounds_;
+
+	// Colour every cell again on the next draw
+	void repaint();
+
+	// Dying states fade from the live colour towards the dead one
+	void update_palette();
+
+	// Shapes the cells are drawn with: hexagons under a hexagonal rule, squares otherwise
+	fan_2d::graphics::rectangle_t& cell_shapes() { return hexagonal_cells_ ? hexes_ : rects_; }
+
+	// Switch between hexagons and squares; the shapes are rebuilt on the next draw
+	void set_hexagonal_cells(bool hexagonal);
+
+	// Drop the cell shapes so the next draw rebuilds them in place
+	void reset_cell_shapes();
+
+	// Screen position of the cell at a one-dimensional (map_) index; hexagonal boards shift odd rows half a cell east
+	fan::vec2 cell_position(uint32_t i) const;
+
+	// Offset rows only line up across an edge that keeps their parity and direction: hexagonal rules run
+	// on a plane or a torus of even height
+	bool topology_fits(const Rule& rule, Topology topology) const;
+
+	// Save current state as the next slot, dropping the slots after the current one if it is an earlier one
+	void save_slot();
+
+	// Last slot of the timeline: the live board, or the latest slot once the board was scrubbed back
+	uint64_t last_slot() const { return std::max<uint64_t>(slot_, history_.empty() ? 0 : history_.size() - 1); }
+
+	// Whether the pointer is over the timeline
+	bool over_timeline() const { return timeline_shown_ && window->get_mouse_position().y >= window->get_size().y - timeline_height; }
+
+	// Move the board to the slot under the pointer while the timeline is dragged, and to exactly that slot
+	// once it is let go
+	void scrub();
+	void end_scrub();
+
+	// Lay the timeline out over the window and move the thumb to the current slot
+	void update_timeline();
+
+	// Reapply the current rule to cells restored from a save or the history, and forget their cycle
+	void restored();
+
+	// Refresh the window from the plane (unbounded mode)
+	void update_view();
+
+	// Hash of the whole pattern: the plane in unbounded mode, the board otherwise
+	uint64_t board_hash() const { return unbounded_ ? plane_.hash() : cells_.hash(); }
+
+	// Count generations evolved and look the board up among the recent ones; returns the period the board
+	// repeats with, or 0. A new period is reported on the console
+	uint64_t observe_cycle(uint64_t generations);
+
+	// The board was changed by hand or set up anew, so its history no longer predicts it
+	void reset_cycle();
+
 	int get_window_divisor() {
-		return (int)sqrt(cells_.size());
+		return cells_.width();
+	}
+
+	// Cell state at a one-dimensional (map_) index
+	bool is_alive(uint32_t i) const {
+		return cells_.get(i % cells_.width(), i / cells_.width());
 	}
 
 	void update_cursor_highlight() { // make proper abstractions
@@ -178,15 +196,15 @@ private:
 		const int cursor_rect_indice = 2;
 
 		int i = translate_mouse_to_gridmap();
-		if (cells_[i].alive) {
+		if (is_alive(i)) {
 			cursor_rects_.set_color(context, filler_rect_indice, color_alive_);
 		}
-		else if (!cells_[i].alive) {
+		else {
 			cursor_rects_.set_color(context, filler_rect_indice, color_dead_);
 		}
 
-		cursor_rects_.set_position(context, bg_rect_indice, map_[i]);
-		cursor_rects_.set_position(context, filler_rect_indice, map_[i]);
+		cursor_rects_.set_position(context, bg_rect_indice, cell_position(i));
+		cursor_rects_.set_position(context, filler_rect_indice, cell_position(i));
 	}
 
 public:
@@ -199,6 +217,29 @@ public:
 
 	inline static bool ticking_ = false;
 
+	// A board repeating with a period up to settle_period_ has settled (1: still lifes only; 0 turns the
+	// detection off). Settling calls on_settled_, and pauses the simulation if pause_when_settled_ is set
+	uint64_t settle_period_ = 2;
+	bool pause_when_settled_ = false;
+
+	// Bytes the history may take in memory before older slots are spilled to disk (up to disk_bytes, in
+	// directory or the system's temporary directory), then thinned out to be recomputed when gone back to
+	void set_history_budget(size_t bytes, uint64_t disk_bytes, const std::string& directory) {
+		history_.budget_ = bytes;
+		history_.disk_budget_ = disk_bytes;
+		if (!directory.empty()) history_.set_spill_directory(directory);
+	}
+	std::function<void(uint64_t period)> on_settled_;
+
+	// Generations covered by a leap, as a power of two, and at most on the bounded board and hexagonal rules,
+	// which are stepped one generation at a time until they repeat
+	int leap_exponent_ = 10;
+	static constexpr int max_stepped_leap_exponent = 20;
+
+	// Generations per simulation tick, and per fast-forward notch of the mouse wheel
+	int generations_per_tick_ = 1;
+	int fast_forward_step_ = 64;
+
 	fan::color color_alive_ = fan::colors::white;
 	fan::color color_dead_ = fan::colors::black;
 	
@@ -225,9 +266,37 @@ public:
 	// Proceed a step in evolution according to the game's rules
 	void evolve();
 
+	// Proceed several generations at once (saved as a single slot)
+	void fast_forward(uint64_t generations);
+
 	// It's evolving, just backwards!
 	void devolve();
 
+	// Show or hide the timeline
+	void toggle_timeline();
+
+	// Jump 2^leap_exponent_ generations ahead at once through HashLife on the unbounded plane; the bounded
+	// board and hexagonal rules are fast-forwarded instead, at most 2^max_stepped_leap_exponent generations
+	void leap();
+
+	// Switch between the bounded board and an unbounded plane seen through the window
+	void set_unbounded(bool unbounded);
+	bool is_unbounded() const { return unbounded_; }
+
+	// Move the window over the plane by a number of cells (unbounded mode)
+	void pan(int dx, int dy);
+
+	// How the edges of the bounded board connect
+	void set_topology(Topology topology);
+	Topology get_topology() const { return cells_.topology(); }
+
+	// Rule in B/S notation, e.g. "B36/S23" or "B2/S34H", or a Larger than Life rule, e.g.
+	// "R5,C0,M1,S34..58,B34..45,NM"; false if it is malformed or cannot run in the current mode
+	bool set_rule(const std::string& rulestring);
+	bool set_rule(const Rule& rule);
+	void set_rule(const LtlRule& rule);
+	const Rule& get_rule() const { return rule_; }
+
 	// Returns the corresponding cell map indice determined from mouse click point
 	uint32_t translate_mouse_to_gridmap();
 
@@ -239,5 +308,22 @@ public:
 	std::vector<Cell> get_live_cells(std::vector<Cell> cells);
 
 	void draw();
+
+	// Counters kept up to date by the engines, for displays and scripts
+	struct Stats {
+		uint64_t generation;	// Generations since the board was set up or last edited
+		uint64_t population;	// Live cells of the whole pattern (the plane in unbounded mode)
+		BitGrid::Bounds bounds;	// Live and dying cells of the board, or of the window onto the plane
+		uint64_t period;	// Last period the board was found to repeat with, 0 if none
+		bool settled;
+		uint64_t history_slots;		// Slots that can be gone back to
+		size_t history_stored;		// Of which stored rather than recomputed on demand
+		size_t history_bytes;
+		uint64_t history_disk_bytes;
+	};
+	Stats stats() const;
+
+	// Print the objects of the board (the window in unbounded mode) by apgcode, once it is known to repeat
+	void print_census();
 };
 
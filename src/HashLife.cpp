@@ -0,0 +1,375 @@
+#include "HashLife.h"
+
+#include <algorithm>
+
+HashLife::HashLife() {
+	nodes_.push_back({ 0, 0, 0, 0, 0, -1, 0, 0 }); // dead_
+	nodes_.push_back({ 0, 0, 0, 0, 0, -1, 0, 1 }); // alive_
+	root_ = empty(3);
+}
+
+HashLife::node_t HashLife::join(node_t nw, node_t ne, node_t sw, node_t se) {
+	Key key = { nw, ne, sw, se };
+	auto it = table_.find(key);
+	if (it != table_.end()) return it->second;
+
+	Node node;
+	node.nw = nw; node.ne = ne; node.sw = sw; node.se = se;
+	node.level = nodes_[nw].level + 1;
+	node.population = nodes_[nw].population + nodes_[ne].population + nodes_[sw].population + nodes_[se].population;
+
+	node_t id = (node_t)nodes_.size();
+	nodes_.push_back(node);
+	table_.emplace(key, id);
+	return id;
+}
+
+HashLife::node_t HashLife::empty(int level) {
+	if (empty_.empty()) empty_.push_back(dead_);
+	while ((int)empty_.size() <= level) {
+		node_t e = empty_.back();
+		empty_.push_back(join(e, e, e, e));
+	}
+	return empty_[level];
+}
+
+HashLife::node_t HashLife::expand(node_t n) {
+	Node node = nodes_[n];
+	node_t e = empty(node.level - 1);
+	return join(
+		join(e, e, e, node.nw), join(e, e, node.ne, e),
+		join(e, node.sw, e, e), join(node.se, e, e, e));
+}
+
+HashLife::node_t HashLife::centre(node_t n) {
+	const Node& node = nodes_[n];
+	return join(nodes_[node.nw].se, nodes_[node.ne].sw, nodes_[node.sw].ne, nodes_[node.se].nw);
+}
+
+HashLife::node_t HashLife::centre_horizontal(node_t w, node_t e) {
+	const Node& a = nodes_[w];
+	const Node& b = nodes_[e];
+	return join(a.ne, b.nw, a.se, b.sw);
+}
+
+HashLife::node_t HashLife::centre_vertical(node_t n, node_t s) {
+	const Node& a = nodes_[n];
+	const Node& b = nodes_[s];
+	return join(a.sw, a.se, b.nw, b.ne);
+}
+
+HashLife::node_t HashLife::evolve_leaf(node_t n) {
+	// Gather the 4x4 cells into a bitmask, bit (y * 4 + x)
+	uint32_t bits = 0;
+	const node_t quadrants[4] = { nodes_[n].nw, nodes_[n].ne, nodes_[n].sw, nodes_[n].se };
+	for (int q = 0; q < 4; q++)
+	{
+		const Node& quadrant = nodes_[quadrants[q]];
+		int x = (q & 1) * 2, y = (q >> 1) * 2;
+		bits |= (uint32_t)(quadrant.nw == alive_) << (y * 4 + x);
+		bits |= (uint32_t)(quadrant.ne == alive_) << (y * 4 + x + 1);
+		bits |= (uint32_t)(quadrant.sw == alive_) << ((y + 1) * 4 + x);
+		bits |= (uint32_t)(quadrant.se == alive_) << ((y + 1) * 4 + x + 1);
+	}
+
+	node_t next_cells[4];
+	for (int i = 0; i < 4; i++)
+	{
+		int x = 1 + (i & 1), y = 1 + (i >> 1);
+		unsigned neighbourhood = 0;
+		for (int dy = -1; dy <= 1; dy++)
+		{
+			neighbourhood |= ((bits >> ((y + dy) * 4 + x - 1)) & 7) << ((dy + 1) * 3);
+		}
+		next_cells[i] = rule_.next(neighbourhood) ? alive_ : dead_;
+	}
+
+	return join(next_cells[0], next_cells[1], next_cells[2], next_cells[3]);
+}
+
+HashLife::node_t HashLife::next(node_t n, int step) {
+	const Node node = nodes_[n];
+	if (node.population == 0) return empty(node.level - 1);
+
+	if (node.result_step == step) {
+		memo_hits_++;
+		return node.result;
+	}
+	memo_misses_++;
+
+	node_t result;
+	if (node.level == 2) {
+		result = evolve_leaf(n);
+	}
+	else {
+		// Nine overlapping sub-nodes one level down
+		node_t n00 = node.nw, n02 = node.ne, n20 = node.sw, n22 = node.se;
+		node_t n01 = centre_horizontal(node.nw, node.ne);
+		node_t n21 = centre_horizontal(node.sw, node.se);
+		node_t n10 = centre_vertical(node.nw, node.sw);
+		node_t n12 = centre_vertical(node.ne, node.se);
+		node_t n11 = centre(n);
+
+		// First half of the step on the nine, then the rest on the four overlapping quadrants they form;
+		// steps shorter than the node allows skip the second half and just take the centres
+		int inner = std::min(step, node.level - 3);
+		node_t r00 = next(n00, inner), r01 = next(n01, inner), r02 = next(n02, inner);
+		node_t r10 = next(n10, inner), r11 = next(n11, inner), r12 = next(n12, inner);
+		node_t r20 = next(n20, inner), r21 = next(n21, inner), r22 = next(n22, inner);
+
+		node_t q00 = join(r00, r01, r10, r11), q01 = join(r01, r02, r11, r12);
+		node_t q10 = join(r10, r11, r20, r21), q11 = join(r11, r12, r21, r22);
+
+		if (step == node.level - 2) {
+			result = join(next(q00, inner), next(q01, inner), next(q10, inner), next(q11, inner));
+		}
+		else {
+			result = join(centre(q00), centre(q01), centre(q10), centre(q11));
+		}
+	}
+
+	// nodes_ may have grown since node was copied
+	nodes_[n].result = result;
+	nodes_[n].result_step = (int8_t)step;
+	return result;
+}
+
+HashLife::node_t HashLife::set(node_t n, int level, int64_t x, int64_t y, bool alive) {
+	if (level == 0) return alive ? alive_ : dead_;
+
+	int64_t half = (int64_t)1 << (level - 1);
+	Node node = nodes_[n];
+	if (y < half) {
+		if (x < half) node.nw = set(node.nw, level - 1, x, y, alive);
+		else node.ne = set(node.ne, level - 1, x - half, y, alive);
+	}
+	else {
+		if (x < half) node.sw = set(node.sw, level - 1, x, y - half, alive);
+		else node.se = set(node.se, level - 1, x - half, y - half, alive);
+	}
+	return join(node.nw, node.ne, node.sw, node.se);
+}
+
+bool HashLife::get(node_t n, int level, int64_t x, int64_t y) const {
+	while (level > 0) {
+		const Node& node = nodes_[n];
+		if (node.population == 0) return false;
+
+		int64_t half = (int64_t)1 << (level - 1);
+		if (y < half) n = x < half ? node.nw : node.ne;
+		else n = x < half ? node.sw : node.se;
+		if (x >= half) x -= half;
+		if (y >= half) y -= half;
+		level--;
+	}
+	return n == alive_;
+}
+
+void HashLife::clear() {
+	root_ = empty(3);
+	generation_ = 0;
+}
+
+void HashLife::set_rule(const Rule& rule) {
+	if (rule == rule_) return;
+
+	rule_ = rule;
+	for (Node& node : nodes_) node.result_step = -1;
+}
+
+void HashLife::set(int64_t x, int64_t y, bool alive) {
+	for (;;) {
+		int64_t half = (int64_t)1 << (nodes_[root_].level - 1);
+		if (x >= -half && x < half && y >= -half && y < half) break;
+		root_ = expand(root_);
+	}
+
+	int level = nodes_[root_].level;
+	int64_t half = (int64_t)1 << (level - 1);
+	root_ = set(root_, level, x + half, y + half, alive);
+}
+
+bool HashLife::get(int64_t x, int64_t y) const {
+	int level = nodes_[root_].level;
+	int64_t half = (int64_t)1 << (level - 1);
+	if (x < -half || x >= half || y < -half || y >= half) return false;
+	return get(root_, level, x + half, y + half);
+}
+
+HashLife::node_t HashLife::build(const word_source_t& word, const Bounds& bounds, int level, int64_t x, int64_t y) {
+	int64_t size = (int64_t)1 << level;
+	if (x >= bounds.x1 || y >= bounds.y1 || x + size <= bounds.x0 || y + size <= bounds.y0) return empty(level);
+
+	// 64x64 blocks are read whole (the root is aligned so these line up with words) and skipped when empty
+	if (level == 6) {
+		uint64_t rows[64];
+		uint64_t any = 0;
+		for (int row = 0; row < 64; row++) any |= rows[row] = word(x, y + row);
+		return any ? build_block(rows, level, 0, 0) : empty(level);
+	}
+
+	int64_t half = size / 2;
+	node_t nw = build(word, bounds, level - 1, x, y);
+	node_t ne = build(word, bounds, level - 1, x + half, y);
+	node_t sw = build(word, bounds, level - 1, x, y + half);
+	node_t se = build(word, bounds, level - 1, x + half, y + half);
+	return join(nw, ne, sw, se);
+}
+
+HashLife::node_t HashLife::build_block(const uint64_t* rows, int level, int x, int y) {
+	if (level == 0) return (rows[y] >> x) & 1 ? alive_ : dead_;
+
+	int half = 1 << (level - 1);
+	node_t nw = build_block(rows, level - 1, x, y);
+	node_t ne = build_block(rows, level - 1, x + half, y);
+	node_t sw = build_block(rows, level - 1, x, y + half);
+	node_t se = build_block(rows, level - 1, x + half, y + half);
+	return join(nw, ne, sw, se);
+}
+
+void HashLife::extract(node_t n, int level, int64_t x, int64_t y, const Bounds& bounds, const std::function<void(int64_t, int64_t)>& cell) const {
+	int64_t size = (int64_t)1 << level;
+	if (nodes_[n].population == 0) return;
+	if (x >= bounds.x1 || y >= bounds.y1 || x + size <= bounds.x0 || y + size <= bounds.y0) return;
+	if (level == 0) {
+		cell(x, y);
+		return;
+	}
+
+	const Node& node = nodes_[n];
+	int64_t half = size / 2;
+	extract(node.nw, level - 1, x, y, bounds, cell);
+	extract(node.ne, level - 1, x + half, y, bounds, cell);
+	extract(node.sw, level - 1, x, y + half, bounds, cell);
+	extract(node.se, level - 1, x + half, y + half, bounds, cell);
+}
+
+int HashLife::root_level(const Bounds& bounds) const {
+	int64_t reach = std::max({ -bounds.x0, -bounds.y0, bounds.x1, bounds.y1, (int64_t)1 });
+
+	int level = 7;
+	while (((int64_t)1 << (level - 1)) < reach) level++;
+	return level;
+}
+
+void HashLife::import(const BitGrid& grid) {
+	Bounds bounds = { 0, 0, grid.width(), grid.height() };
+	int level = root_level(bounds);
+	int64_t half = (int64_t)1 << (level - 1);
+
+	root_ = build([&](int64_t x, int64_t y) {
+		return x >= 0 && y >= 0 && x < grid.width() && y < grid.height() ? grid.row((int)y)[x >> 6] : 0;
+	}, bounds, level, -half, -half);
+	generation_ = 0;
+}
+
+void HashLife::export_to(BitGrid& grid) const {
+	grid.clear();
+
+	int level = nodes_[root_].level;
+	int64_t half = (int64_t)1 << (level - 1);
+	extract(root_, level, -half, -half, { 0, 0, grid.width(), grid.height() }, [&](int64_t x, int64_t y) {
+		grid.set((int)x, (int)y, true);
+	});
+}
+
+void HashLife::import(const TileMap& plane) {
+	Bounds bounds = { 0, 0, 0, 0 };
+	bool first = true;
+	plane.for_each_tile([&](int64_t tx, int64_t ty, const TileMap::Tile&) {
+		int64_t x = tx * TileMap::tile_size, y = ty * TileMap::tile_size;
+		if (first) bounds = { x, y, x, y };
+		bounds = { std::min(bounds.x0, x), std::min(bounds.y0, y), std::max(bounds.x1, x + TileMap::tile_size), std::max(bounds.y1, y + TileMap::tile_size) };
+		first = false;
+	});
+
+	int level = root_level(bounds);
+	int64_t half = (int64_t)1 << (level - 1);
+	root_ = build([&](int64_t x, int64_t y) { return plane.word(x, y); }, bounds, level, -half, -half);
+	generation_ = 0;
+}
+
+void HashLife::export_to(TileMap& plane) const {
+	plane.clear();
+
+	int level = nodes_[root_].level;
+	int64_t half = (int64_t)1 << (level - 1);
+	extract(root_, level, -half, -half, { -half, -half, half, half }, [&](int64_t x, int64_t y) {
+		plane.set(x, y, true);
+	});
+}
+
+void HashLife::advance(int k) {
+	if (nodes_.size() > max_nodes_) collect();
+
+	// Grow until the pattern fits in the middle quarter of a root at least two levels above the step
+	for (;;) {
+		const Node& root = nodes_[root_];
+		if (root.level >= k + 2) {
+			const Node& nw = nodes_[root.nw], & ne = nodes_[root.ne], & sw = nodes_[root.sw], & se = nodes_[root.se];
+			uint64_t inner = nodes_[nw.se].population + nodes_[ne.sw].population + nodes_[sw.ne].population + nodes_[se.nw].population;
+			if (inner == root.population) break;
+		}
+		root_ = expand(root_);
+	}
+
+	// One more level leaves room for everything the pattern can reach in 2^k generations
+	root_ = next(expand(root_), k);
+	generation_ += (uint64_t)1 << k;
+}
+
+void HashLife::mark(node_t n, std::vector<bool>& live, bool keep_results) const {
+	if (live[n]) return;
+	live[n] = true;
+
+	const Node& node = nodes_[n];
+	if (node.level == 0) return;
+
+	mark(node.nw, live, keep_results);
+	mark(node.ne, live, keep_results);
+	mark(node.sw, live, keep_results);
+	mark(node.se, live, keep_results);
+	if (keep_results && node.result_step >= 0) mark(node.result, live, keep_results);
+}
+
+void HashLife::collect() {
+	// Keep memoized results of surviving nodes unless that alone would keep the table too big
+	for (bool keep_results : { true, false })
+	{
+		std::vector<bool> live(nodes_.size(), false);
+		live[dead_] = live[alive_] = true;
+		for (node_t e : empty_) mark(e, live, keep_results);
+		mark(root_, live, keep_results);
+
+		size_t survivors = std::count(live.begin(), live.end(), true);
+		if (keep_results && survivors > max_nodes_ / 2) continue;
+
+		// Children always precede their parents, so compacting in place keeps them resolvable
+		std::vector<node_t> remap(nodes_.size(), 0);
+		node_t count = 0;
+		for (node_t i = 0; i < nodes_.size(); i++)
+		{
+			if (live[i]) remap[i] = count++;
+		}
+
+		table_.clear();
+		for (node_t i = 0; i < nodes_.size(); i++)
+		{
+			if (!live[i]) continue;
+
+			Node node = nodes_[i];
+			if (node.level > 0) {
+				node.nw = remap[node.nw]; node.ne = remap[node.ne]; node.sw = remap[node.sw]; node.se = remap[node.se];
+				table_.emplace(Key{ node.nw, node.ne, node.sw, node.se }, remap[i]);
+			}
+			if (node.result_step >= 0 && keep_results) node.result = remap[node.result];
+			else node.result_step = -1;
+			nodes_[remap[i]] = node;
+		}
+		nodes_.resize(count);
+
+		for (node_t& e : empty_) e = remap[e];
+		root_ = remap[root_];
+		return;
+	}
+}
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+#include "BitGrid.h"
+#include "TileMap.h"
+
+/// <summary>
+///
+/// HashLife engine: the plane is a quadtree of canonical (hash-consed) nodes, and the centre of every
+/// node advanced by 2^(level-2) generations is memoized on the node itself. Repeating structure in space
+/// and time is computed once, which lets breeders and guns run for billions of generations.
+///
+/// Coordinates are unbounded; the root is always centred on the origin and grows as the pattern does.
+///
+/// </summary>
+
+class HashLife
+{
+private:
+	typedef uint32_t node_t;
+
+	struct Node {
+		node_t nw, ne, sw, se;
+		node_t result = 0;		// Memoized centre advanced by 2^result_step generations
+		int8_t result_step = -1;	// -1 while no result is memoized
+		uint8_t level;
+		uint64_t population;
+	};
+
+	struct Key {
+		node_t nw, ne, sw, se;
+		bool operator==(const Key& other) const {
+			return nw == other.nw && ne == other.ne && sw == other.sw && se == other.se;
+		}
+	};
+
+	struct KeyHash {
+		size_t operator()(const Key& k) const {
+			uint64_t h = ((uint64_t)k.nw * 0x9e3779b97f4a7c15ull) ^ ((uint64_t)k.ne * 0xc2b2ae3d27d4eb4full);
+			h ^= ((uint64_t)k.sw * 0x165667b19e3779f9ull) ^ ((uint64_t)k.se * 0x27d4eb2f165667c5ull);
+			return (size_t)(h ^ (h >> 29));
+		}
+	};
+
+	// Nodes 0 and 1 are the dead and live cell (level 0)
+	static constexpr node_t dead_ = 0;
+	static constexpr node_t alive_ = 1;
+
+	std::vector<Node> nodes_;
+	std::unordered_map<Key, node_t, KeyHash> table_;
+	std::vector<node_t> empty_; // Empty node of each level
+
+	node_t root_ = dead_;
+	uint64_t generation_ = 0;
+
+	Rule rule_;
+
+	uint64_t memo_hits_ = 0;
+	uint64_t memo_misses_ = 0;
+
+	// Node count past which unreachable nodes are collected between steps
+	size_t max_nodes_ = (size_t)1 << 22;
+
+	node_t join(node_t nw, node_t ne, node_t sw, node_t se);
+	node_t empty(int level);
+
+	// One level bigger with n in the middle
+	node_t expand(node_t n);
+
+	// Middle quarter of n, one level below it
+	node_t centre(node_t n);
+
+	// Node straddling two neighbours of the same level
+	node_t centre_horizontal(node_t w, node_t e);
+	node_t centre_vertical(node_t n, node_t s);
+
+	// Centre of a level-2 node after one generation
+	node_t evolve_leaf(node_t n);
+
+	// Centre of n advanced by 2^step generations, step <= level - 2
+	node_t next(node_t n, int step);
+
+	node_t set(node_t n, int level, int64_t x, int64_t y, bool alive);
+	bool get(node_t n, int level, int64_t x, int64_t y) const;
+
+	// 64 cells of row y from column x (a multiple of 64), bit i is column x + i
+	typedef std::function<uint64_t(int64_t x, int64_t y)> word_source_t;
+
+	// Region [x0, x1) x [y0, y1) outside of which every cell is dead
+	struct Bounds {
+		int64_t x0, y0, x1, y1;
+	};
+
+	node_t build(const word_source_t& word, const Bounds& bounds, int level, int64_t x, int64_t y);
+	node_t build_block(const uint64_t* rows, int level, int x, int y);
+	void extract(node_t n, int level, int64_t x, int64_t y, const Bounds& bounds, const std::function<void(int64_t, int64_t)>& cell) const;
+
+	// Root with its top left corner at (-half, -half) large enough for bounds
+	int root_level(const Bounds& bounds) const;
+
+	void mark(node_t n, std::vector<bool>& live, bool keep_results) const;
+
+public:
+	HashLife();
+
+	// Kill every cell (memoized results are kept for later patterns)
+	void clear();
+
+	void set(int64_t x, int64_t y, bool alive);
+	bool get(int64_t x, int64_t y) const;
+
+	// Replace the pattern with the board, cell (x, y) of the board landing on (x, y)
+	void import(const BitGrid& grid);
+
+	// Write the window [0, width) x [0, height) of the plane back into the board
+	void export_to(BitGrid& grid) const;
+
+	// Same for an unbounded plane, which takes the whole pattern
+	void import(const TileMap& plane);
+	void export_to(TileMap& plane) const;
+
+	// Memoized results only hold for the rule they were computed under, so changing it forgets them.
+	// Only rules with Rule::needs_bounded_board() false are supported: B0 would bring the whole empty plane to
+	// life and nodes hold no dying states
+	const Rule& rule() const { return rule_; }
+	void set_rule(const Rule& rule);
+
+	// Advance the pattern by 2^k generations
+	void advance(int k);
+
+	// Drop every node unreachable from the current pattern
+	void collect();
+
+	uint64_t generation() const { return generation_; }
+	uint64_t population() const { return nodes_[root_].population; }
+
+	// Counters
+	size_t node_count() const { return nodes_.size(); }
+	uint64_t memo_hits() const { return memo_hits_; }
+	uint64_t memo_misses() const { return memo_misses_; }
+	double memo_hit_rate() const {
+		return memo_hits_ + memo_misses_ ? (double)memo_hits_ / (double)(memo_hits_ + memo_misses_) : 0;
+	}
+};
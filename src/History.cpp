@@ -0,0 +1,535 @@
+#include "History.h"
+#include "DeltaCodec.h"
+
+#include <algorithm>
+#include <bit>
+#include <random>
+
+namespace {
+
+// Delta covering two consecutive deltas: the words changed by either, XORed together. Both are in order of index
+BitGrid::Delta compose(const BitGrid::Delta& first, const BitGrid::Delta& second) {
+	BitGrid::Delta delta;
+	delta.reserve(first.size() + second.size());
+
+	size_t i = 0, j = 0;
+	while (i < first.size() || j < second.size())
+	{
+		if (j == second.size() || (i < first.size() && first[i].first < second[j].first)) delta.push_back(first[i++]);
+		else if (i == first.size() || second[j].first < first[i].first) delta.push_back(second[j++]);
+		else {
+			uint64_t bits = first[i].second ^ second[j].second;
+			if (bits) delta.emplace_back(first[i].first, bits);
+			i++;
+			j++;
+		}
+	}
+	return delta;
+}
+
+TileMap::Delta compose(const TileMap::Delta& first, const TileMap::Delta& second) {
+	TileMap::Delta all(first);
+	all.insert(all.end(), second.begin(), second.end());
+	std::sort(all.begin(), all.end(), [](const TileMap::Change& a, const TileMap::Change& b) {
+		return a.key != b.key ? a.key < b.key : a.row < b.row;
+	});
+
+	TileMap::Delta delta;
+	for (const TileMap::Change& change : all)
+	{
+		if (!delta.empty() && delta.back().key == change.key && delta.back().row == change.row) delta.back().bits ^= change.bits;
+		else delta.push_back(change);
+		if (delta.back().bits == 0) delta.pop_back();
+	}
+	return delta;
+}
+
+}
+
+History::~History() {
+	{
+		std::lock_guard<std::mutex> lock(packer_mutex_);
+		stopping_ = true;
+	}
+	packer_wake_.notify_one();
+	if (packer_.joinable()) packer_.join();
+}
+
+void History::packer_main() {
+	std::unique_lock<std::mutex> lock(packer_mutex_);
+	while (true) {
+		packer_wake_.wait(lock, [this] { return stopping_ || !to_pack_.empty(); });
+		if (stopping_) return;
+
+		Packing packing = std::move(to_pack_.front());
+		to_pack_.pop_front();
+		lock.unlock();
+		packing.packed = DeltaCodec::pack(packing.delta->cells, packing.delta->plane);
+		lock.lock();
+		packed_.push_back(std::move(packing));
+	}
+}
+
+void History::pack(const Entry& entry) {
+	{
+		std::lock_guard<std::mutex> lock(packer_mutex_);
+		to_pack_.push_back({ entry.slot, entry.delta, {} });
+		if (!packer_.joinable()) packer_ = std::thread(&History::packer_main, this);
+	}
+	packer_wake_.notify_one();
+}
+
+void History::take_packed() {
+	std::vector<Packing> done;
+	{
+		std::lock_guard<std::mutex> lock(packer_mutex_);
+		done.swap(packed_);
+	}
+
+	// Entries merged, popped or forgotten since were handed in again or are gone
+	for (Packing& packing : done)
+	{
+		if (entries_.empty() || packing.slot < entries_[0].slot) continue;
+		Entry& entry = entries_[find(packing.slot)];
+		if (entry.slot != packing.slot || entry.delta != packing.delta) continue;
+
+		bytes_ -= bytes(entry);
+		entry.packed = std::move(packing.packed);
+		entry.delta.reset();
+		bytes_ += bytes(entry);
+	}
+}
+
+size_t History::bytes(const Delta& delta) {
+	return sizeof(Delta) + delta.cells.capacity() * sizeof(delta.cells[0]) + delta.plane.capacity() * sizeof(TileMap::Change);
+}
+
+size_t History::bytes(const Entry& entry) {
+	size_t bytes = sizeof(Entry) + entry.packed.capacity();
+	if (entry.keyframe) bytes += sizeof(Keyframe);
+	if (entry.delta) bytes += History::bytes(*entry.delta);
+	return bytes;
+}
+
+size_t History::overhead() const {
+	size_t bytes = steps_.size() * sizeof(Step) + (entries_.capacity() - entries_.size()) * sizeof(Entry);
+	return bytes + last_cells_.bytes() + last_plane_.bytes() + cursor_cells_.bytes() + cursor_plane_.bytes();
+}
+
+std::shared_ptr<const History::Delta> History::delta(const Entry& entry) const {
+	if (entry.delta) return entry.delta;
+
+	for (const auto& [slot, delta] : unpacked_)
+	{
+		if (slot == entry.slot) return delta;
+	}
+
+	// A segment that can't be mapped back, or a delta that doesn't decode, can't be rebuilt from
+	auto delta = std::make_shared<Delta>();
+	const uint8_t* packed = entry.spilled ? spill_.read(entry.location) : entry.packed.data();
+	size_t size = entry.spilled ? entry.location.size : entry.packed.size();
+	if (!DeltaCodec::unpack(packed, size, delta->cells, delta->plane)) return nullptr;
+
+	unpacked_.emplace_back(entry.slot, delta);
+	unpacked_size_ += entry.words;
+	unpacked_bytes_ += bytes(*delta);
+	while ((unpacked_size_ > unpacked_words || unpacked_bytes_ > budget_ / 4) && unpacked_.size() > 1)
+	{
+		unpacked_size_ -= unpacked_.front().second->cells.size() + unpacked_.front().second->plane.size();
+		unpacked_bytes_ -= bytes(*unpacked_.front().second);
+		unpacked_.pop_front();
+	}
+	return delta;
+}
+
+size_t History::find(uint64_t slot) const {
+	auto it = std::upper_bound(entries_.begin(), entries_.end(), slot, [](uint64_t slot, const Entry& entry) { return slot < entry.slot; });
+	return (size_t)(it - entries_.begin()) - 1;
+}
+
+BitGrid History::blank(const Keyframe& frame) {
+	BitGrid cells(frame.width, frame.height);
+	cells.set_topology(frame.topology);
+	cells.set_rule(frame.rule);
+	return cells;
+}
+
+void History::push(const BitGrid& cells, const TileMap& plane, uint64_t generations, bool unbounded) {
+	take_packed();
+
+	Entry entry;
+	entry.slot = size();
+	steps_.push_back({ generations, unbounded });
+
+	// A new keyframe once the deltas since the last one add up to as many words as it has, so that rebuilding
+	// a state costs at most about twice reading the board, however much it changes
+	size_t since_keyframe = 0, chain_words = 0;
+	while (since_keyframe < entries_.size() && !entries_[entries_.size() - 1 - since_keyframe].keyframe)
+	{
+		chain_words += entries_[entries_.size() - 1 - since_keyframe].words;
+		since_keyframe++;
+	}
+	bool keyframe = entries_.empty() || since_keyframe + 1 >= keyframe_interval ||
+		chain_words >= std::max<size_t>(entries_[entries_.size() - 1 - since_keyframe].words, min_chain_words);
+
+	// A board of another size, topology or rule can't be a delta from the one before
+	auto delta = std::make_shared<Delta>();
+	if (!keyframe && last_cells_.delta(cells, delta->cells)) {
+		last_plane_.delta(plane, delta->plane);
+		last_cells_.apply(delta->cells);
+		last_plane_.apply(delta->plane);
+	}
+	else {
+		entry.keyframe = std::make_unique<Keyframe>();
+		Keyframe& frame = *entry.keyframe;
+		frame.width = cells.width();
+		frame.height = cells.height();
+		frame.topology = cells.topology();
+		frame.rule = cells.rule();
+		frame.plane_rule = plane.rule();
+		blank(frame).delta(cells, delta->cells);
+		TileMap().delta(plane, delta->plane);
+
+		last_cells_ = cells;
+		last_plane_ = plane;
+	}
+	delta->cells.shrink_to_fit();
+	delta->plane.shrink_to_fit();
+	entry.delta = delta;
+	entry.words = delta->cells.size() + delta->plane.size();
+
+	bytes_ += bytes(entry);
+	pack(entry);
+	entries_.push_back(std::move(entry));
+	if (bytes() > budget_) enforce_budget();
+}
+
+bool History::get(uint64_t slot, BitGrid& cells, TileMap& plane) {
+	if (slot < first_slot_ || slot >= size()) return false;
+
+	uint64_t stored = slot;
+	if (!seek(stored, cells, plane)) return false;
+	replay(stored, slot, cells, plane);
+	return true;
+}
+
+bool History::seek(uint64_t& slot, BitGrid& cells, TileMap& plane) {
+	if (slot < first_slot_ || slot >= size()) return false;
+	take_packed();
+
+	if (slot >= entries_.back().slot) {
+		cells = last_cells_;
+		plane = last_plane_;
+		slot = entries_.back().slot;
+		return true;
+	}
+
+	size_t entry = find(slot);
+	if (!seek_entry(entry)) return false;
+	cells = cursor_cells_;
+	plane = cursor_plane_;
+	slot = entries_[entry].slot;
+	return true;
+}
+
+void History::reset_cursor() {
+	cursor_ = none;
+	unpacked_.clear();
+	unpacked_size_ = unpacked_bytes_ = 0;
+}
+
+bool History::seek_entry(size_t entry) {
+	auto keyframe_before = [this](size_t i) {
+		while (!entries_[i].keyframe) i--;
+		return i;
+	};
+
+	size_t cursor = cursor_;
+	cursor_ = none;
+	if (cursor == none || keyframe_before(cursor) != keyframe_before(entry)) {
+		if (!rebuild(entry, cursor_cells_, cursor_plane_)) return false;
+	}
+	else {
+		// Deltas are their own inverse, so going back applies the same ones as coming forward
+		for (size_t i = std::min(cursor, entry) + 1; i <= std::max(cursor, entry); i++)
+		{
+			std::shared_ptr<const Delta> delta = this->delta(entries_[i]);
+			if (!delta) return false;
+			cursor_cells_.apply(delta->cells);
+			cursor_plane_.apply(delta->plane);
+		}
+	}
+	cursor_ = entry;
+	return true;
+}
+
+bool History::rebuild(size_t entry, BitGrid& cells, TileMap& plane) const {
+	size_t k = entry;
+	while (!entries_[k].keyframe) k--;
+
+	const Keyframe& frame = *entries_[k].keyframe;
+	cells = blank(frame);
+	plane = TileMap();
+	plane.set_rule(frame.plane_rule);
+
+	for (size_t i = k; i <= entry; i++)
+	{
+		std::shared_ptr<const Delta> delta = this->delta(entries_[i]);
+		if (!delta) return false;
+		cells.apply(delta->cells);
+		plane.apply(delta->plane);
+	}
+	return true;
+}
+
+void History::replay(uint64_t from, uint64_t to, BitGrid& cells, TileMap& plane) const {
+	uint64_t generations = 0;
+	for (uint64_t slot = from + 1; slot <= to; slot++) generations += steps_[slot - first_slot_].generations;
+
+	if (steps_[to - first_slot_].unbounded) {
+		for (uint64_t i = 0; i < generations; i++) plane.evolve();
+		return;
+	}
+	while (generations > 0)
+	{
+		int n = (int)std::min<uint64_t>(generations, 1 << 20);
+		cells.evolve_n(n);
+		generations -= n;
+	}
+}
+
+bool History::merge_into_next(size_t entry) {
+	Entry& dropped = entries_[entry];
+	Entry& next = entries_[entry + 1];
+
+	// A keyframe is a delta from the empty board, so the keyframe before carries over to the next state the same way
+	if (!next.keyframe) {
+		std::shared_ptr<const Delta> first = delta(dropped), second = delta(next);
+		if (!first || !second) return false;
+
+		bytes_ -= bytes(dropped) + bytes(next);
+		auto merged = std::make_shared<Delta>();
+		merged->cells = compose(first->cells, second->cells);
+		merged->plane = compose(first->plane, second->plane);
+		merged->cells.shrink_to_fit();
+		merged->plane.shrink_to_fit();
+
+		release(dropped);
+		release(next);
+		next.delta = merged;
+		next.words = merged->cells.size() + merged->plane.size();
+		next.packed = std::vector<uint8_t>();
+		if (dropped.keyframe) next.keyframe = std::move(dropped.keyframe);
+		pack(next);
+
+		// What was unpacked of the next entry no longer holds
+		reset_cursor();
+		bytes_ += bytes(next);
+	}
+	else {
+		release(dropped);
+		bytes_ -= bytes(dropped);
+	}
+	return true;
+}
+
+void History::release(Entry& entry) {
+	if (!entry.spilled) return;
+	spill_.release(entry.location);
+	entry.spilled = false;
+}
+
+void History::thin(uint64_t recent) {
+	if (entries_.size() < 3) return;
+	uint64_t latest = entries_.back().slot;
+
+	// The first and the latest entries stay; every entry dropped folds into the one after it
+	std::vector<Entry> kept;
+	kept.push_back(std::move(entries_[0]));
+	for (size_t i = 1; i + 1 < entries_.size(); i++)
+	{
+		uint64_t slot = entries_[i].slot, age = latest - slot;
+		uint64_t spacing = age < recent ? 1 : (uint64_t)1 << std::bit_width(age / recent);
+		if (slot % spacing == 0 || steps_[slot - first_slot_].generations == 0 || !merge_into_next(i)) kept.push_back(std::move(entries_[i]));
+	}
+	kept.push_back(std::move(entries_.back()));
+	entries_ = std::move(kept);
+}
+
+void History::spill(size_t target) {
+	for (Entry& entry : entries_)
+	{
+		if (bytes_ + overhead() <= target || spill_.bytes() >= disk_budget_) return;
+		if (entry.spilled) continue;
+
+		// The packer may lag behind a fast simulation; deltas it has not got to yet are packed here
+		std::vector<uint8_t> packed = entry.delta ? DeltaCodec::pack(entry.delta->cells, entry.delta->plane) : entry.packed;
+		SegmentStore::Location location;
+		if (!spill_.append(packed.data(), packed.size(), location)) return;
+		bytes_ -= bytes(entry);
+		entry.delta.reset();
+		entry.packed = std::vector<uint8_t>();
+		entry.spilled = true;
+		entry.location = location;
+		bytes_ += bytes(entry);
+	}
+}
+
+void History::enforce_budget() {
+	// The cursor is rebuilt by the next lookup, so its boards need not take up the budget until then
+	reset_cursor();
+	cursor_cells_ = BitGrid();
+	cursor_plane_ = TileMap();
+	size_t target = budget_ / 4 * 3;
+	spill(target);
+	for (uint64_t recent = recent_slots; recent > 0 && bytes_ + overhead() > target; recent /= 2) thin(recent);
+
+	// Forget the oldest states, the one after them becoming the first
+	size_t forget = 0;
+	while (bytes_ + overhead() > target && forget + 1 < entries_.size() && merge_into_next(forget)) forget++;
+	if (forget == 0) return;
+
+	entries_.erase(entries_.begin(), entries_.begin() + forget);
+	steps_.erase(steps_.begin(), steps_.begin() + (entries_[0].slot - first_slot_));
+	first_slot_ = entries_[0].slot;
+}
+
+void History::pop(BitGrid& cells, TileMap& plane) {
+	take_packed();
+	reset_cursor();
+	cells = last_cells_;
+	plane = last_plane_;
+
+	Entry entry = std::move(entries_.back());
+	entries_.pop_back();
+	steps_.pop_back();
+	bytes_ -= bytes(entry);
+	if (entries_.empty()) {
+		// Slots keep their numbers, so the next one is saved where this one was
+		uint64_t first = first_slot_;
+		clear();
+		first_slot_ = first;
+		return;
+	}
+
+	// XOR deltas are their own inverse; past a keyframe the state before has to be rebuilt. If it can't be,
+	// nothing before it can be gone back to
+	std::shared_ptr<const Delta> delta = entry.keyframe ? nullptr : this->delta(entry);
+	if (delta) {
+		last_cells_.apply(delta->cells);
+		last_plane_.apply(delta->plane);
+	}
+	release(entry);
+	if (!delta && !rebuild(entries_.size() - 1, last_cells_, last_plane_)) {
+		uint64_t next = size();
+		clear();
+		first_slot_ = next;
+		return;
+	}
+	store_latest();
+}
+
+void History::truncate(uint64_t slot) {
+	if (slot >= size()) return;
+	if (slot <= first_slot_) {
+		clear();
+		first_slot_ = slot;
+		return;
+	}
+
+	take_packed();
+	reset_cursor();
+	while (entries_.back().slot >= slot)
+	{
+		release(entries_.back());
+		bytes_ -= bytes(entries_.back());
+		entries_.pop_back();
+	}
+	steps_.resize(slot - first_slot_);
+
+	if (!rebuild(entries_.size() - 1, last_cells_, last_plane_)) {
+		clear();
+		first_slot_ = slot;
+		return;
+	}
+	store_latest();
+}
+
+void History::store_latest() {
+	// The latest state is always stored, so one that was thinned out is recomputed and stored again
+	uint64_t latest = size() - 1;
+	if (entries_.back().slot == latest) return;
+
+	Entry restored;
+	restored.slot = latest;
+	BitGrid latest_cells = last_cells_;
+	TileMap latest_plane = last_plane_;
+	replay(entries_.back().slot, latest, latest_cells, latest_plane);
+
+	auto delta = std::make_shared<Delta>();
+	last_cells_.delta(latest_cells, delta->cells);
+	last_plane_.delta(latest_plane, delta->plane);
+	restored.delta = delta;
+	restored.words = delta->cells.size() + delta->plane.size();
+	last_cells_ = latest_cells;
+	last_plane_ = latest_plane;
+
+	bytes_ += bytes(restored);
+	pack(restored);
+	entries_.push_back(std::move(restored));
+}
+
+void History::clear() {
+	{
+		std::lock_guard<std::mutex> lock(packer_mutex_);
+		to_pack_.clear();
+		packed_.clear();
+	}
+	entries_.clear();
+	steps_.clear();
+	spill_.close();
+	reset_cursor();
+	first_slot_ = 0;
+	bytes_ = 0;
+	last_cells_ = BitGrid();
+	last_plane_.clear();
+}
+
+bool History::self_check(uint32_t seed) {
+	History history;
+	history.budget_ = (size_t)512 << 10;
+	history.disk_budget_ = 0;
+
+	BitGrid cells(256, 256);
+	TileMap plane;
+	std::mt19937 random(seed);
+	for (int y = 0; y < cells.height(); y++)
+	{
+		for (int x = 0; x < cells.width(); x++) cells.set(x, y, random() % 3 == 0);
+	}
+
+	// Single generations, with a leap of a few every so often that only its stored state can bring back
+	std::vector<uint64_t> hashes;
+	for (int slot = 0; slot < 2000; slot++)
+	{
+		uint64_t generations = 1;
+		if (slot == 0) generations = 0;
+		else if (slot % 97 == 0) {
+			cells.evolve_n(7);
+			generations = 0;
+		}
+		else cells.evolve();
+
+		history.push(cells, plane, generations, false);
+		hashes.push_back(cells.hash());
+	}
+
+	if (history.stored() == history.size() - history.first()) return false;
+	for (uint64_t slot = history.first(); slot < history.size(); slot++)
+	{
+		BitGrid restored;
+		TileMap restored_plane;
+		if (!history.get(slot, restored, restored_plane) || restored.hash() != hashes[slot]) return false;
+	}
+	return true;
+}
@@ -0,0 +1,231 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "BitGrid.h"
+#include "SegmentStore.h"
+#include "TileMap.h"
+
+/// <summary>
+///
+/// Every saved state of the board, oldest first. A state is stored as the words that changed since the one
+/// before it (XOR deltas), with a keyframe holding the whole board every keyframe_interval states or sooner
+/// on a board that changes a lot, so memory follows how much the board changes rather than how big it is.
+/// Any state is rebuilt from the nearest keyframe before it; dropping the latest one undoes its delta in place.
+///
+/// The history stays within a byte budget, which counts the boards and steps it keeps besides the stored
+/// states. Past it, older states are thinned out logarithmically: every state of the last recent_slots is
+/// kept, every 2nd one before that, every 4th before those and so on. A thinned-out state is recomputed on demand by evolving the nearest stored one before it, so only states the
+/// board was stepped into (not edited or leaped into) are thinned. If that is still not enough, the oldest
+/// states are forgotten.
+///
+/// Deltas are packed with DeltaCodec by a thread of their own, so saving a state only costs finding the
+/// words that changed; packed deltas replace the plain ones the next time the history is used.
+///
+/// Entries are kept in order of slot, so a slot's stored state is found by binary search. The state reached
+/// by the last lookup is kept as a cursor: a lookup within the same run of deltas applies only the deltas in
+/// between, forwards or backwards, so scrubbing costs about as much as the board changes along the way.
+///
+/// Before anything is thinned out, the oldest packed deltas are spilled to segment files on disk, up to a
+/// disk budget, and mapped back in when a state is rebuilt from them. Only the entries, which index the
+/// states by slot, stay in memory.
+///
+/// </summary>
+
+class History
+{
+public:
+	// Most deltas between keyframes, and the words they may add up to before a keyframe is due even if the
+	// last keyframe has fewer
+	static constexpr size_t keyframe_interval = 64;
+	static constexpr size_t min_chain_words = 4096;
+	static constexpr uint64_t recent_slots = 256;
+
+	// Bytes the history may take in memory: the stored states, the steps, the latest and cursor states and the
+	// unpacked deltas. Spilling and thinning bring all but the unpacked deltas down to three quarters of it, and
+	// the unpacked deltas keep to the last quarter
+	size_t budget_ = (size_t)1 << 30;
+
+	// Bytes that may be spilled to disk; 0 keeps the history in memory
+	uint64_t disk_budget_ = (uint64_t)16 << 30;
+
+private:
+	// Words that changed, plain or packed
+	struct Delta {
+		BitGrid::Delta cells;
+		TileMap::Delta plane;
+	};
+
+	// Size, topology and rules of a keyframe's board; its words are a delta from the empty board and plane
+	struct Keyframe {
+		int width = 0;
+		int height = 0;
+		Topology topology = Topology::plane;
+		Rule rule;
+		Rule plane_rule;
+	};
+
+	// A stored state: a keyframe, or nullptr and the delta from the stored state before. The delta is
+	// plain until the packer's result comes in, and may then be spilled to disk
+	struct Entry {
+		uint64_t slot = 0;
+		std::unique_ptr<Keyframe> keyframe;
+		std::shared_ptr<const Delta> delta;
+		std::vector<uint8_t> packed;
+		size_t words = 0;	// Changed words the delta holds
+		bool spilled = false;
+		SegmentStore::Location location;
+	};
+
+	// How a state followed from the one before: the generations it was stepped, 0 if it can't be recomputed
+	// that way, and on which engine
+	struct Step {
+		uint64_t generations = 0;
+		bool unbounded = false;
+	};
+
+	// Delta handed to the packer, and what it made of it
+	struct Packing {
+		uint64_t slot;
+		std::shared_ptr<const Delta> delta;
+		std::vector<uint8_t> packed;
+	};
+
+	std::vector<Entry> entries_;	// Stored states, oldest first; the first and the latest are always stored
+	std::deque<Step> steps_;		// Every state from first_slot_ on
+	uint64_t first_slot_ = 0;
+	size_t bytes_ = 0;				// Of the entries; overhead() adds the rest
+
+	// Spilled deltas; those of entries merged, popped, truncated or forgotten are released, so the disk budget
+	// counts only the deltas still in use
+	mutable SegmentStore spill_;
+
+	// The latest state, which the next one is compared against
+	BitGrid last_cells_;
+	TileMap last_plane_;
+
+	// Stored entry whose state the last lookup rebuilt, or none once entries were dropped or moved
+	static constexpr size_t none = (size_t)-1;
+	size_t cursor_ = none;
+	BitGrid cursor_cells_;
+	TileMap cursor_plane_;
+
+	// Move the cursor to an entry; false, leaving no cursor, if a delta on the way can't be read
+	bool seek_entry(size_t entry);
+
+	// Recently unpacked deltas by slot, oldest first, so that scrubbing back and forth unpacks each once
+	static constexpr size_t unpacked_words = (size_t)1 << 21;
+	mutable std::deque<std::pair<uint64_t, std::shared_ptr<const Delta>>> unpacked_;
+	mutable size_t unpacked_size_ = 0;
+	mutable size_t unpacked_bytes_ = 0;
+
+	// Forget the cursor and the unpacked deltas, once entries were dropped or merged
+	void reset_cursor();
+
+	// Packer thread, started with the first delta; the results are taken in by the thread using the history
+	std::thread packer_;
+	std::mutex packer_mutex_;
+	std::condition_variable packer_wake_;
+	std::deque<Packing> to_pack_;
+	std::vector<Packing> packed_;
+	bool stopping_ = false;
+
+	void packer_main();
+
+	// Queue an entry's plain delta, and swap in the packed deltas that are ready if their entries still hold
+	// the same delta
+	void pack(const Entry& entry);
+	void take_packed();
+
+	static size_t bytes(const Delta& delta);
+	static size_t bytes(const Entry& entry);
+
+	// Memory taken besides the entries and the unpacked deltas: the steps, spare room in the entry index and
+	// the latest and cursor states
+	size_t overhead() const;
+
+	// The entry's delta, unpacked if need be; nullptr if it can't be read back
+	std::shared_ptr<const Delta> delta(const Entry& entry) const;
+
+	// Stored entry of the slot, or the latest one before it
+	size_t find(uint64_t slot) const;
+
+	// Rebuild a stored state from the keyframe before it; false if a delta on the way can't be read
+	bool rebuild(size_t entry, BitGrid& cells, TileMap& plane) const;
+
+	// Evolve a state from one slot to a later one, through the steps in between
+	void replay(uint64_t from, uint64_t to, BitGrid& cells, TileMap& plane) const;
+
+	// Fold an entry into the next one, which then holds the delta (or keyframe) covering both; the entry is
+	// left for the caller to erase. False, changing nothing, if either delta can't be read
+	bool merge_into_next(size_t entry);
+
+	// Release an entry's spilled delta, once it is dropped or replaced
+	void release(Entry& entry);
+
+	// Move the oldest packed deltas to disk until under the target
+	void spill(size_t target);
+
+	// Thin out states at least recent slots old; then forget the oldest ones if needed
+	void thin(uint64_t recent);
+	void enforce_budget();
+
+	// Store the latest slot again if it was thinned out, last_cells_ and last_plane_ holding the latest
+	// stored state
+	void store_latest();
+
+	// Empty board of the keyframe's size, topology and rule
+	static BitGrid blank(const Keyframe& frame);
+
+public:
+	History() {}
+	History(const History&) = delete;
+	History& operator=(const History&) = delete;
+	~History();
+
+	// Slots ever saved, and the earliest one still available
+	uint64_t size() const { return first_slot_ + steps_.size(); }
+	uint64_t first() const { return first_slot_; }
+	bool empty() const { return steps_.empty(); }
+
+	// States stored rather than recomputed, the bytes the history takes in memory (as counted against the
+	// budget) and the bytes of the states spilled to disk
+	size_t stored() const { return entries_.size(); }
+	size_t bytes() const { return bytes_ + overhead() + unpacked_bytes_; }
+	uint64_t disk_bytes() const { return spill_.bytes(); }
+
+	// Directory to spill to; the system's temporary directory by default
+	void set_spill_directory(const std::string& directory) { spill_.set_directory(directory); }
+
+	// Save a state as the next slot, saying how many generations it was stepped from the one before on the
+	// bounded board or the unbounded plane (0 if it was edited, leaped or otherwise can't be recomputed)
+	void push(const BitGrid& cells, const TileMap& plane, uint64_t generations, bool unbounded);
+
+	// Rebuild the state of a slot; false if it is not available or can't be read back from disk. On the
+	// unbounded plane a recomputed state's window is left as it was stored and should be refreshed from the plane
+	bool get(uint64_t slot, BitGrid& cells, TileMap& plane);
+
+	// Rebuild the stored state nearest a slot at or before it, without recomputing anything, and move slot to
+	// it; for previews while scrubbing. False if the slot is not available or can't be read back
+	bool seek(uint64_t& slot, BitGrid& cells, TileMap& plane);
+
+	// Drop the latest state, handing it back
+	void pop(BitGrid& cells, TileMap& plane);
+
+	// Drop every state from a slot on, e.g. to go on from an earlier one
+	void truncate(uint64_t slot);
+
+	void clear();
+
+	// Saves a random soup's generations, with leaps among them, under a budget small enough to thin them out,
+	// and checks that every slot still rebuilds to the state it was saved as
+	static bool self_check(uint32_t seed = 0x5eed);
+};
@@ -0,0 +1,294 @@
+#include "LargerThanLife.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+
+static bool parse_int(const std::string& text, size_t& i, int& value) {
+	size_t start = i;
+	value = 0;
+	while (i < text.size() && std::isdigit((unsigned char)text[i]) && value < 100000) value = value * 10 + (text[i++] - '0');
+	return i != start;
+}
+
+// "34..58"
+static bool parse_range(const std::string& text, size_t& i, int& min, int& max) {
+	if (!parse_int(text, i, min)) return false;
+	if (text.compare(i, 2, "..") != 0) return false;
+	i += 2;
+	return parse_int(text, i, max);
+}
+
+bool LtlRule::parse(const std::string& rulestring, LtlRule& rule) {
+	std::string text;
+	for (char c : rulestring)
+	{
+		if (!std::isspace((unsigned char)c)) text += (char)std::toupper((unsigned char)c);
+	}
+	if (text.empty()) return false;
+
+	LtlRule parsed;
+	size_t i = 0;
+
+	if (std::isdigit((unsigned char)text[0])) {
+		// Short form: radius,birth min,birth max,survival min,survival max
+		int* fields[] = { &parsed.radius, &parsed.birth_min, &parsed.birth_max, &parsed.survival_min, &parsed.survival_max };
+		for (int f = 0; f < 5; f++)
+		{
+			if (f > 0 && (i >= text.size() || text[i++] != ',')) return false;
+			if (!parse_int(text, i, *fields[f])) return false;
+		}
+		if (i != text.size()) return false;
+	}
+	else {
+		bool seen_radius = false, seen_birth = false, seen_survival = false;
+		while (i < text.size()) {
+			char letter = text[i++];
+			int value = 0;
+
+			if (letter == 'R') {
+				if (!parse_int(text, i, parsed.radius)) return false;
+				seen_radius = true;
+			}
+			else if (letter == 'C') {
+				if (!parse_int(text, i, value) || (value != 0 && value != 2)) return false;
+			}
+			else if (letter == 'M') {
+				if (!parse_int(text, i, value) || value > 1) return false;
+				parsed.middle = value == 1;
+			}
+			else if (letter == 'S') {
+				if (!parse_range(text, i, parsed.survival_min, parsed.survival_max)) return false;
+				seen_survival = true;
+			}
+			else if (letter == 'B') {
+				if (!parse_range(text, i, parsed.birth_min, parsed.birth_max)) return false;
+				seen_birth = true;
+			}
+			else if (letter == 'N' && i < text.size() && (text[i] == 'M' || text[i] == 'N')) {
+				parsed.shape = text[i++] == 'M' ? Shape::moore : Shape::von_neumann;
+			}
+			else return false;
+
+			if (i < text.size() && text[i++] != ',') return false;
+		}
+		if (!seen_radius || !seen_birth || !seen_survival) return false;
+	}
+
+	if (parsed.radius < 1 || parsed.radius > max_radius) return false;
+	if (parsed.birth_min > parsed.birth_max || parsed.survival_min > parsed.survival_max) return false;
+
+	rule = parsed;
+	return true;
+}
+
+std::string LtlRule::to_string() const {
+	return "R" + std::to_string(radius) + ",C0,M" + (middle ? "1" : "0") +
+		",S" + std::to_string(survival_min) + ".." + std::to_string(survival_max) +
+		",B" + std::to_string(birth_min) + ".." + std::to_string(birth_max) +
+		(shape == Shape::moore ? ",NM" : ",NN");
+}
+
+// Row y of the board, one cell per element, with margin cells on both sides taken from across the edges.
+// y may lie beyond the board too; the topology decides what is there (nothing on a plane)
+static void unpack_row(const BitGrid& grid, int y, int margin, uint16_t* cells) {
+	int w = grid.width(), h = grid.height();
+	bool plane = grid.topology() == Topology::plane;
+
+	bool mirrored = false;
+	if (y < 0 || y >= h) {
+		if (plane) {
+			std::fill(cells, cells + w + 2 * margin, 0);
+			return;
+		}
+		int crossings = y < 0 ? (-y - 1) / h + 1 : y / h;
+		mirrored = grid.topology() == Topology::klein && (crossings & 1);
+		y = ((y % h) + h) % h;
+	}
+
+	const uint64_t* row = grid.row(y);
+	auto cell = [&](int x) -> uint16_t {
+		if (mirrored) x = w - 1 - x;
+		return (row[x >> 6] >> (x & 63)) & 1;
+	};
+
+	if (mirrored) {
+		for (int x = 0; x < w; x++) cells[margin + x] = cell(x);
+	}
+	else {
+		for (size_t i = 0; i < grid.words(); i++)
+		{
+			uint64_t word = row[i];
+			int n = std::min(64, w - (int)i * 64);
+			for (int b = 0; b < n; b++) cells[margin + i * 64 + b] = (word >> b) & 1;
+		}
+	}
+
+	for (int i = 0; i < margin; i++)
+	{
+		cells[margin - 1 - i] = plane ? 0 : cell(((-1 - i) % w + w) % w);
+		cells[margin + w + i] = plane ? 0 : cell(i % w);
+	}
+}
+
+void LargerThanLife::apply(const BitGrid& grid, int y, const uint16_t* counts, uint64_t* out) const {
+	const uint64_t* alive = grid.row(y);
+	int w = grid.width();
+
+	for (size_t i = 0; i < grid.words(); i++)
+	{
+		uint64_t word = alive[i], next = 0;
+		int n = std::min(64, w - (int)i * 64);
+		for (int b = 0; b < n; b++) next |= (uint64_t)table_[counts[i * 64 + b] * 2 + ((word >> b) & 1)] << b;
+		out[i] = next;
+	}
+}
+
+// Counts are kept in uint16_t with wrapping arithmetic throughout: prefix sums overflow on wide boards, but
+// every count is a difference of two of them and well below 2^16
+
+void LargerThanLife::evolve_moore(const BitGrid& grid, int y0, int y1, uint64_t* out) const {
+	const int r = rule_.radius, w = grid.width(), span = 2 * r + 1;
+
+	thread_local std::vector<uint16_t> cells, prefix, windows, incoming, counts;
+	cells.resize((size_t)w + 2 * r);
+	prefix.resize((size_t)w + 2 * r + 1);
+	windows.resize((size_t)span * w);
+	incoming.resize(w);
+	counts.assign(w, 0);
+
+	// Live cells of row y within r columns of each cell
+	auto horizontal = [&](int y, uint16_t* window) {
+		unpack_row(grid, y, r, cells.data());
+		prefix[0] = 0;
+		for (int i = 0; i < w + 2 * r; i++) prefix[i + 1] = prefix[i] + cells[i];
+		for (int x = 0; x < w; x++) window[x] = prefix[x + span] - prefix[x];
+	};
+
+	// Window counts of the span rows around the current one, row y in slot y mod span
+	auto slot = [&](int y) { return &windows[(size_t)(((y % span) + span) % span) * w]; };
+
+	for (int y = y0 - r; y <= y0 + r; y++)
+	{
+		uint16_t* window = slot(y);
+		horizontal(y, window);
+		for (int x = 0; x < w; x++) counts[x] += window[x];
+	}
+
+	for (int y = y0;; y++)
+	{
+		apply(grid, y, counts.data(), out + (size_t)(y - y0) * grid.words());
+		if (y + 1 == y1) break;
+
+		// Slide the square down a row: row y + r + 1 comes in, row y - r (same slot) goes out
+		uint16_t* outgoing = slot(y - r);
+		horizontal(y + r + 1, incoming.data());
+		for (int x = 0; x < w; x++) counts[x] += incoming[x] - outgoing[x];
+		std::copy(incoming.begin(), incoming.end(), outgoing);
+	}
+}
+
+void LargerThanLife::evolve_von_neumann(const BitGrid& grid, int y0, int y1, uint64_t* out) const {
+	const int r = rule_.radius, w = grid.width(), margin = r + 1, padded = w + 2 * margin, rows = 2 * r + 3;
+
+	// Prefix sums along both diagonals: down_right[x, y] = cell[x, y] + down_right[x - 1, y - 1] and
+	// down_left[x, y] = cell[x, y] + down_left[x + 1, y - 1], for the rows the diamond edges touch
+	thread_local std::vector<uint16_t> cells, prefix, down_right, down_left, counts;
+	cells.resize(padded);
+	prefix.resize((size_t)padded + 1);
+	down_right.resize((size_t)rows * padded);
+	down_left.resize((size_t)rows * padded);
+	counts.assign(w, 0);
+
+	auto slot = [&](std::vector<uint16_t>& diagonal, int y) { return &diagonal[(size_t)(((y % rows) + rows) % rows) * padded]; };
+
+	auto diagonal_row = [&](int y, bool first) {
+		unpack_row(grid, y, margin, cells.data());
+		uint16_t* right = slot(down_right, y);
+		uint16_t* left = slot(down_left, y);
+		if (first) {
+			std::copy(cells.begin(), cells.end(), right);
+			std::copy(cells.begin(), cells.end(), left);
+			return;
+		}
+
+		const uint16_t* right_above = slot(down_right, y - 1);
+		const uint16_t* left_above = slot(down_left, y - 1);
+		right[0] = cells[0];
+		for (int i = 1; i < padded; i++) right[i] = cells[i] + right_above[i - 1];
+		left[padded - 1] = cells[padded - 1];
+		for (int i = 0; i < padded - 1; i++) left[i] = cells[i] + left_above[i + 1];
+	};
+
+	// The first row's diamonds directly, a row of it at a time: row y0 + dy contributes r - |dy| columns either side
+	for (int dy = -r; dy <= r; dy++)
+	{
+		unpack_row(grid, y0 + dy, margin, cells.data());
+		prefix[0] = 0;
+		for (int i = 0; i < padded; i++) prefix[i + 1] = prefix[i] + cells[i];
+
+		int half = r - std::abs(dy);
+		for (int x = 0; x < w; x++) counts[x] += prefix[x + margin + half + 1] - prefix[x + margin - half];
+	}
+
+	for (int y = y0 - r - 1; y <= y0 + r + 1; y++) diagonal_row(y, y == y0 - r - 1);
+
+	for (int y = y0;; y++)
+	{
+		apply(grid, y, counts.data(), out + (size_t)(y - y0) * grid.words());
+		if (y + 1 == y1) break;
+
+		if (y > y0) diagonal_row(y + r + 1, false);
+
+		// Moving the diamond down a row adds its lower edges (a V with its tip at row y + 1 + r) and drops the
+		// upper edges of the old one (a V with its tip at row y - r); each arm is a difference of diagonal sums
+		const uint16_t* right_low = slot(down_right, y + 1 + r);
+		const uint16_t* right_mid = slot(down_right, y);
+		const uint16_t* right_high = slot(down_right, y - r);
+		const uint16_t* left_low = slot(down_left, y + r);
+		const uint16_t* left_mid = slot(down_left, y);
+		const uint16_t* left_high = slot(down_left, y - r - 1);
+
+		for (int x = 0; x < w; x++)
+		{
+			int c = x + margin;
+			uint16_t added = (right_low[c] - right_mid[c - r - 1]) + (left_low[c + 1] - left_mid[c + r + 1]);
+			uint16_t removed = (left_mid[c - r] - left_high[c + 1]) + (right_mid[c + r] - right_high[c]);
+			counts[x] += added - removed;
+		}
+	}
+}
+
+void LargerThanLife::evolve(BitGrid& grid) {
+	int h = grid.height();
+	size_t words = grid.words();
+	if (grid.width() == 0 || h == 0) return;
+
+	next_.assign(words * h, 0);
+
+	// Next state by count (which includes the cell itself) and current state
+	int area = (2 * rule_.radius + 1) * (2 * rule_.radius + 1);
+	table_.assign((size_t)(area + 1) * 2, 0);
+	for (int count = 0; count <= area; count++)
+	{
+		table_[count * 2] = count >= rule_.birth_min && count <= rule_.birth_max;
+		int others = rule_.middle ? count : count - 1;
+		table_[count * 2 + 1] = count > 0 && others >= rule_.survival_min && others <= rule_.survival_max;
+	}
+
+	// Bands of rows, each starting its sliding sums afresh; tall enough that the start-up stays cheap
+	ThreadPool& pool = ThreadPool::shared();
+	int band = std::max((h + (int)pool.size() * 4 - 1) / ((int)pool.size() * 4), 4 * rule_.radius);
+	int bands = (h + band - 1) / band;
+
+	pool.parallel_for(bands, [&](size_t b) {
+		int y0 = (int)b * band, y1 = std::min(y0 + band, h);
+		uint64_t* out = &next_[(size_t)y0 * words];
+		if (rule_.shape == LtlRule::Shape::moore) evolve_moore(grid, y0, y1, out);
+		else evolve_von_neumann(grid, y0, y1, out);
+	});
+
+	for (int y = 0; y < h; y++) std::copy(&next_[(size_t)y * words], &next_[(size_t)(y + 1) * words], grid.row(y));
+	grid.wake_all();
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "BitGrid.h"
+
+/// <summary>
+///
+/// Larger than Life: outer-totalistic rules over a range-R neighbourhood (R up to 10), either the square
+/// Moore neighbourhood or the von Neumann diamond. Counts are never summed cell by cell: Moore slides a
+/// horizontal window along each row and a vertical one down the board, von Neumann moves the diamond down a
+/// row by adding and removing its edges through diagonal prefix sums. Either way the cost per cell does not
+/// depend on the radius.
+///
+/// </summary>
+
+struct LtlRule {
+	enum class Shape { moore, von_neumann };
+
+	static constexpr int max_radius = 10;
+
+	int radius = 5;
+	Shape shape = Shape::moore;
+	bool middle = true; // Whether a cell counts itself
+
+	// Inclusive ranges of the neighbour count
+	int birth_min = 34, birth_max = 45;
+	int survival_min = 34, survival_max = 58;
+
+	bool operator==(const LtlRule& other) const {
+		return radius == other.radius && shape == other.shape && middle == other.middle && birth_min == other.birth_min &&
+			birth_max == other.birth_max && survival_min == other.survival_min && survival_max == other.survival_max;
+	}
+
+	// Parses "R5,C0,M1,S34..58,B34..45,NM" (NN for von Neumann) or the short form "5,34,45,34,58" (radius, birth
+	// range, survival range; Moore, middle counted); false if malformed. Only two-state rules (C0 or C2)
+	static bool parse(const std::string& text, LtlRule& rule);
+
+	std::string to_string() const;
+};
+
+struct NamedLtlRule {
+	const char* name;
+	const char* rule;
+};
+
+inline constexpr NamedLtlRule preset_ltl_rules[] = {
+	{ "Bugs", "R5,C0,M1,S34..58,B34..45,NM" },
+	{ "Bosco", "R5,C0,M1,S33..57,B34..45,NM" },
+	{ "Bugsmovie", "R10,C0,M1,S123..212,B123..170,NM" },
+	{ "Majority", "R4,C0,M1,S41..81,B41..81,NM" },
+	{ "Waffle", "R7,C0,M1,S100..200,B75..170,NM" },
+	{ "Globe", "R8,C0,M0,S163..223,B74..252,NM" },
+};
+
+class LargerThanLife
+{
+private:
+	LtlRule rule_;
+
+	// Next generation, words() words per row without guards
+	std::vector<uint64_t> next_;
+
+	// Next state of a cell, indexed by count * 2 + alive
+	std::vector<uint8_t> table_;
+
+	void evolve_moore(const BitGrid& grid, int y0, int y1, uint64_t* out) const;
+	void evolve_von_neumann(const BitGrid& grid, int y0, int y1, uint64_t* out) const;
+
+	// Turn the counts of row y into the row's next generation
+	void apply(const BitGrid& grid, int y, const uint16_t* counts, uint64_t* out) const;
+
+public:
+	const LtlRule& rule() const { return rule_; }
+	void set_rule(const LtlRule& rule) { rule_ = rule; }
+
+	// Proceed a generation; the grid's topology decides what lies beyond its edges
+	void evolve(BitGrid& grid);
+};
@@ -0,0 +1,238 @@
+#include "Rule.h"
+
+#include <array>
+#include <cctype>
+#include <cstring>
+#include <utility>
+
+// Hensel letters of each neighbour count in canonical order; counts above 4 reuse the letters of 8 - count
+// for the complementary arrangements
+static const char* const hensel_letters[9] = { "", "ce", "ceaikn", "ceaiknjqry", "ceaiknjqrytwz", "ceaiknjqry", "ceaikn", "ce", "" };
+
+// One arrangement per letter of counts 1 to 4, laid out as Rule::table; the others are its rotations and reflections
+static const uint16_t hensel_arrangements[5][13] = {
+	{ 0 },
+	{ 1, 2 },
+	{ 5, 10, 3, 40, 33, 68 },
+	{ 69, 42, 11, 7, 98, 13, 14, 70, 41, 97 },
+	{ 325, 170, 15, 45, 99, 71, 106, 102, 43, 101, 105, 78, 108 },
+};
+
+static int letter_count(int n) {
+	return n == 0 || n == 8 ? 1 : (int)std::strlen(hensel_letters[n]);
+}
+
+// The representative arrangement of letter l of count n
+static unsigned arrangement(int n, int l) {
+	return n <= 4 ? hensel_arrangements[n][l] : hensel_arrangements[8 - n][l] ^ 0x1ef;
+}
+
+// Letter index of every neighbourhood within its count; the centre cell does not matter
+static const std::array<uint8_t, 512>& letter_classes() {
+	static const std::array<uint8_t, 512> classes = [] {
+		std::array<uint8_t, 512> result = {};
+		for (int n = 1; n <= 4; n++)
+		{
+			for (int l = 0; l < letter_count(n); l++)
+			{
+				// All eight symmetries of the square: mirror columns, mirror rows, transpose
+				for (int s = 0; s < 8; s++)
+				{
+					unsigned image = 0;
+					for (int bit = 0; bit < 9; bit++)
+					{
+						if (((hensel_arrangements[n][l] >> bit) & 1) == 0) continue;
+						int row = bit / 3, column = bit % 3;
+						if (s & 1) column = 2 - column;
+						if (s & 2) row = 2 - row;
+						if (s & 4) std::swap(row, column);
+						image |= 1u << (row * 3 + column);
+					}
+
+					for (unsigned neighbourhood : { image, image ^ 0x1ef })
+					{
+						if (n == 4 && neighbourhood != image) continue;
+						result[neighbourhood] = result[neighbourhood | 0x10] = (uint8_t)l;
+					}
+				}
+			}
+		}
+		return result;
+	}();
+	return classes;
+}
+
+// Reads neighbour counts, each optionally followed by the Hensel letters it is limited to (or, after a minus,
+// the letters it excludes), up to the next separator; letters[n] collects the allowed letters of count n
+static bool parse_counts(const std::string& text, size_t& i, uint16_t letters[9]) {
+	for (int n = 0; n < 9; n++) letters[n] = 0;
+
+	// Without separators, a c followed by nothing but digits up to the end is the number of states of a lower
+	// case Generations rule, as in b2s345c4, rather than a letter; with them the states are a field of their
+	// own, so B3/S2c3 keeps its letter
+	auto states_suffix = [&text](size_t at) {
+		if (text[at] != 'c' || text.find('/') != std::string::npos) return false;
+		size_t end = at + 1;
+		while (end < text.size() && std::isdigit((unsigned char)text[end])) end++;
+		return end > at + 1 && end == text.size();
+	};
+
+	while (i < text.size() && std::isdigit((unsigned char)text[i])) {
+		int n = text[i++] - '0';
+		if (n > 8) return false;
+
+		bool exclude = i < text.size() && text[i] == '-';
+		if (exclude) i++;
+
+		uint16_t named = 0;
+		while (i < text.size() && std::strchr("ceaiknjqrytwz", text[i]) != nullptr && !states_suffix(i)) {
+			const char* letter = std::strchr(hensel_letters[n], text[i++]);
+			if (letter == nullptr) return false;
+			named |= 1 << (letter - hensel_letters[n]);
+		}
+		if (exclude && named == 0) return false;
+
+		uint16_t all = (uint16_t)((1 << letter_count(n)) - 1);
+		letters[n] |= named == 0 ? all : exclude ? all & ~named : named;
+	}
+	return true;
+}
+
+// Splits the allowed letters of a field into whole and partial counts
+static void set_counts(const uint16_t letters[9], uint16_t& counts, uint16_t& partial) {
+	counts = partial = 0;
+	for (int n = 0; n < 9; n++)
+	{
+		if (letters[n] == (1 << letter_count(n)) - 1) counts |= 1 << n;
+		else if (letters[n] != 0) partial |= 1 << n;
+	}
+}
+
+// False if the counts do not fit the neighbourhood: Hensel letters only name Moore arrangements
+static bool build_rule(const uint16_t birth[9], const uint16_t survival[9], uint16_t states, Rule::Shape shape, Rule& rule) {
+	Rule built(0, 0, states, shape);
+	set_counts(birth, built.birth, built.birth_partial);
+	set_counts(survival, built.survival, built.survival_partial);
+
+	if (shape != Rule::Shape::moore) {
+		uint16_t possible = (uint16_t)((2 << built.max_neighbours()) - 1);
+		if (built.non_totalistic() || ((built.birth | built.survival) & ~possible)) return false;
+	}
+
+	if (built.non_totalistic()) {
+		const std::array<uint8_t, 512>& classes = letter_classes();
+		for (unsigned neighbourhood = 0; neighbourhood < 512; neighbourhood++)
+		{
+			const uint16_t* letters = (neighbourhood & 0x10) ? survival : birth;
+			int n = std::popcount(neighbourhood & 0x1ef);
+			if ((letters[n] >> classes[neighbourhood]) & 1) built.table[neighbourhood >> 6] |= (uint64_t)1 << (neighbourhood & 63);
+		}
+	}
+
+	rule = built;
+	return true;
+}
+
+static bool parse_states(const std::string& text, size_t& i, uint16_t& states) {
+	int value = 0;
+	size_t start = i;
+	while (i < text.size() && std::isdigit((unsigned char)text[i]) && value <= 256) value = value * 10 + (text[i++] - '0');
+	if (i == start || value < 2 || value > 256) return false;
+
+	states = (uint16_t)value;
+	return true;
+}
+
+bool Rule::parse(const std::string& rulestring, Rule& rule) {
+	// Case only matters to Hensel letters, which are lower case
+	std::string text;
+	for (char c : rulestring)
+	{
+		if (!std::isspace((unsigned char)c)) text += c;
+	}
+	if (text.empty()) return false;
+
+	// Neighbourhood suffix
+	Shape shape = Shape::moore;
+	char suffix = (char)std::toupper((unsigned char)text.back());
+	if (suffix == 'H' || suffix == 'V') {
+		shape = suffix == 'H' ? Shape::hexagonal : Shape::von_neumann;
+		text.pop_back();
+		if (text.empty()) return false;
+	}
+
+	uint16_t birth[9], survival[9], states = 2;
+	size_t i = 0;
+
+	// Older notation without B and S: survival/birth, optionally followed by /states
+	if (std::isdigit((unsigned char)text[0]) || text[0] == '/') {
+		if (!parse_counts(text, i, survival)) return false;
+		if (i >= text.size() || text[i] != '/') return false;
+		i++;
+		if (!parse_counts(text, i, birth)) return false;
+		if (i < text.size() && text[i] == '/') {
+			i++;
+			if (!parse_states(text, i, states)) return false;
+		}
+		if (i != text.size()) return false;
+		return build_rule(birth, survival, states, shape, rule);
+	}
+
+	bool seen_birth = false, seen_survival = false, seen_states = false;
+	while (i < text.size()) {
+		char letter = (char)std::toupper((unsigned char)text[i++]);
+		if (letter == 'B' && !seen_birth) {
+			if (!parse_counts(text, i, birth)) return false;
+			seen_birth = true;
+		}
+		else if (letter == 'S' && !seen_survival) {
+			if (!parse_counts(text, i, survival)) return false;
+			seen_survival = true;
+		}
+		else if ((letter == 'C' || letter == 'G') && seen_survival && !seen_states) {
+			if (!parse_states(text, i, states)) return false;
+			seen_states = true;
+		}
+		else if (std::isdigit((unsigned char)letter) && seen_birth && seen_survival && !seen_states) {
+			i--;
+			if (!parse_states(text, i, states)) return false;
+			seen_states = true;
+		}
+		else return false;
+
+		if (i < text.size() && text[i] == '/') i++;
+	}
+	if (!seen_birth || !seen_survival) return false;
+
+	return build_rule(birth, survival, states, shape, rule);
+}
+
+// Counts of one field; partial counts list their letters, or the letters they exclude when that is shorter
+static std::string counts_to_string(const Rule& rule, bool alive) {
+	uint16_t counts = alive ? rule.survival : rule.birth;
+	uint16_t partial = alive ? rule.survival_partial : rule.birth_partial;
+
+	std::string text;
+	for (int n = 0; n <= 8; n++)
+	{
+		if ((counts >> n) & 1) text += (char)('0' + n);
+		if (((partial >> n) & 1) == 0) continue;
+
+		std::string included, excluded;
+		for (int l = 0; l < letter_count(n); l++)
+		{
+			unsigned neighbourhood = arrangement(n, l) | (alive ? 0x10 : 0);
+			((rule.table[neighbourhood >> 6] >> (neighbourhood & 63)) & 1 ? included : excluded) += hensel_letters[n][l];
+		}
+		text += (char)('0' + n);
+		text += excluded.size() < included.size() ? "-" + excluded : included;
+	}
+	return text;
+}
+
+std::string Rule::to_string() const {
+	std::string text = "B" + counts_to_string(*this, false) + "/S" + counts_to_string(*this, true);
+	if (multistate()) text += "/C" + std::to_string(states);
+	if (shape != Shape::moore) text += shape == Shape::hexagonal ? "H" : "V";
+	return text;
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <bit>
+#include <cstdint>
+#include <string>
+
+/// <summary>
+///
+/// Outer-totalistic rule in B/S notation: bit n of birth/survival is set if a dead/live cell with n live
+/// neighbours is alive next generation. Conway's Life is B3/S23.
+///
+/// Generations rules (B/S/C) add states: a live cell that does not survive passes through states - 2
+/// dying states before it is dead, and dying cells neither count as neighbours nor can be born.
+///
+/// Isotropic non-totalistic rules (Hensel notation, e.g. B2n3/S23-q) qualify a count with letters naming
+/// arrangements of the neighbours. Counts that only apply to some arrangements are kept apart in
+/// birth_partial/survival_partial and resolved through a table over the whole 3x3 neighbourhood.
+///
+/// A suffix picks another neighbourhood (Golly's notation): H for the 6 neighbours of a hexagonal grid,
+/// e.g. B2/S34H, and V for the 4 orthogonal neighbours (von Neumann), e.g. B2/S013V. Hexagonal boards are
+/// stored as offset rows, odd rows shifted half a cell east, so which diagonals count depends on the row.
+///
+/// </summary>
+
+struct Rule {
+	enum class Shape { moore, hexagonal, von_neumann };
+
+	uint16_t birth = 1 << 3;
+	uint16_t survival = (1 << 2) | (1 << 3);
+	uint16_t states = 2; // 2 to 256
+	Shape shape = Shape::moore;
+
+	// Counts that apply to some arrangements of the neighbours only; zero for outer-totalistic rules
+	uint16_t birth_partial = 0;
+	uint16_t survival_partial = 0;
+
+	// Next state by neighbourhood, bit (north row | centre row << 3 | south row << 6) with each row west to
+	// east from its lowest bit; only filled in for non-totalistic rules
+	uint64_t table[8] = {};
+
+	constexpr Rule() {}
+	constexpr Rule(uint16_t birth, uint16_t survival, uint16_t states = 2, Shape shape = Shape::moore) : birth(birth), survival(survival), states(states), shape(shape) {}
+
+	constexpr bool operator==(const Rule& other) const {
+		for (int i = 0; i < 8; i++) if (table[i] != other.table[i]) return false;
+		return birth == other.birth && survival == other.survival && states == other.states && shape == other.shape &&
+			birth_partial == other.birth_partial && survival_partial == other.survival_partial;
+	}
+	constexpr bool operator!=(const Rule& other) const { return !(*this == other); }
+
+	constexpr bool non_totalistic() const { return (birth_partial | survival_partial) != 0; }
+
+	// Outer-totalistic rules only
+	constexpr bool next(bool alive, int neighbours) const {
+		return ((alive ? survival : birth) >> neighbours) & 1;
+	}
+
+	// Highest neighbour count of the shape
+	constexpr int max_neighbours() const {
+		return shape == Shape::moore ? 8 : shape == Shape::hexagonal ? 6 : 4;
+	}
+
+	// Cells of a 3x3 neighbourhood laid out as in table that are neighbours of the centre one; on hexagonal
+	// boards the diagonals to the west on even rows and to the east on odd ones
+	constexpr unsigned neighbour_mask(bool odd_row = false) const {
+		if (shape == Shape::hexagonal) return odd_row ? 0x1ae : 0xeb;
+		return shape == Shape::von_neumann ? 0xaa : 0x1ef;
+	}
+
+	// Any rule, from the neighbourhood laid out as in table
+	constexpr bool next(unsigned neighbourhood, bool odd_row = false) const {
+		bool alive = (neighbourhood >> 4) & 1;
+		int neighbours = std::popcount(neighbourhood & neighbour_mask(odd_row));
+		if ((((alive ? survival_partial : birth_partial) >> neighbours) & 1) == 0) return next(alive, neighbours);
+		return (table[neighbourhood >> 6] >> (neighbourhood & 63)) & 1;
+	}
+
+	// Rules with B0 turn the empty background alive, which only bounded boards can represent
+	constexpr bool births_from_nothing() const { return birth & 1; }
+
+	constexpr bool multistate() const { return states > 2; }
+
+	// Bitplanes needed for the age of a dying cell (1 to states - 2)
+	constexpr int age_planes() const { return multistate() ? (int)std::bit_width((unsigned)states - 2) : 0; }
+
+	// HashLife and the unbounded plane only handle two-state rules that leave empty space empty
+	constexpr bool needs_bounded_board() const { return births_from_nothing() || multistate(); }
+
+	// Parses "B36/S23", "b3s23", "S23/B3", "B2/S345/C4", "B2n3/S23-q", "B2/S34H" or the older survival/birth(/states)
+	// forms "23/3" and "345/2/4"; false if malformed
+	static bool parse(const std::string& text, Rule& rule);
+
+	std::string to_string() const;
+};
+
+struct NamedRule {
+	const char* name;
+	Rule rule;
+};
+
+// Rules with kernels specialized at compile time (the states do not matter to the kernel); every other rule
+// runs through the generic kernel
+inline constexpr NamedRule preset_rules[] = {
+	{ "Life", Rule(1 << 3, (1 << 2) | (1 << 3)) },												// B3/S23
+	{ "HighLife", Rule((1 << 3) | (1 << 6), (1 << 2) | (1 << 3)) },								// B36/S23
+	{ "Day & Night", Rule((1 << 3) | (1 << 6) | (1 << 7) | (1 << 8), (1 << 3) | (1 << 4) | (1 << 6) | (1 << 7) | (1 << 8)) }, // B3678/S34678
+	{ "Seeds", Rule(1 << 2, 0) },																// B2/S
+	{ "Life without Death", Rule(1 << 3, 0x1ff) },												// B3/S012345678
+	{ "Maze", Rule(1 << 3, 0x3e) },																// B3/S12345
+	{ "Replicator", Rule(0xaa, 0xaa) },															// B1357/S1357
+	{ "2x2", Rule((1 << 3) | (1 << 6), (1 << 1) | (1 << 2) | (1 << 5)) },						// B36/S125
+	{ "Diamoeba", Rule((1 << 3) | (1 << 5) | (1 << 6) | (1 << 7) | (1 << 8), 0x1e0) },			// B35678/S5678
+	{ "Morley", Rule((1 << 3) | (1 << 6) | (1 << 8), (1 << 2) | (1 << 4) | (1 << 5)) },			// B368/S245
+	{ "Anneal", Rule((1 << 4) | (1 << 6) | (1 << 7) | (1 << 8), (1 << 3) | 0x1e0) },				// B4678/S35678
+	{ "DryLife", Rule((1 << 3) | (1 << 7), (1 << 2) | (1 << 3)) },								// B37/S23
+	{ "Brian's Brain", Rule(1 << 2, 0, 3) },													// B2/S/C3
+	{ "Star Wars", Rule(1 << 2, (1 << 3) | (1 << 4) | (1 << 5), 4) },							// B2/S345/C4
+};
@@ -0,0 +1,142 @@
+#include "SegmentStore.h"
+
+#include <chrono>
+#include <filesystem>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+bool SegmentStore::create_segment() {
+	if (prefix_.empty()) {
+		if (directory_.empty()) {
+			std::error_code error;
+			directory_ = std::filesystem::temp_directory_path(error).string();
+		}
+		uint64_t tag = (uint64_t)std::chrono::steady_clock::now().time_since_epoch().count() ^ (uint64_t)(uintptr_t)this;
+		prefix_ = "congol-history-" + std::to_string(tag % 1000000007) + "-";
+	}
+
+	// The number of a deleted segment is taken again
+	size_t number = 0;
+	while (number < segments_.size() && segments_[number].file != -1) number++;
+
+	Segment segment;
+	segment.path = (std::filesystem::path(directory_) / (prefix_ + std::to_string(number) + ".seg")).string();
+#ifdef _WIN32
+	HANDLE file = CreateFileA(segment.path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_TEMPORARY, nullptr);
+	if (file == INVALID_HANDLE_VALUE) return false;
+	segment.file = (intptr_t)file;
+#else
+	int file = ::open(segment.path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+	if (file < 0) return false;
+	segment.file = file;
+#endif
+	if (number == segments_.size()) segments_.push_back(segment);
+	else segments_[number] = segment;
+	current_ = number;
+	return true;
+}
+
+bool SegmentStore::append(const uint8_t* data, size_t size, Location& location) {
+	if (current_ == none || segments_[current_].size + size > segment_bytes) {
+		if (!create_segment()) return false;
+	}
+
+	Segment& segment = segments_[current_];
+#ifdef _WIN32
+	OVERLAPPED at = {};
+	at.Offset = (DWORD)segment.size;
+	at.OffsetHigh = (DWORD)(segment.size >> 32);
+	DWORD written = 0;
+	if (!WriteFile((HANDLE)segment.file, data, (DWORD)size, &written, &at) || written != size) return false;
+#else
+	for (size_t done = 0; done < size;)
+	{
+		ssize_t written = ::pwrite((int)segment.file, data + done, size - done, (off_t)(segment.size + done));
+		if (written <= 0) return false;
+		done += (size_t)written;
+	}
+#endif
+
+	location = { (uint32_t)current_, (uint32_t)size, segment.size };
+	segment.size += size;
+	segment.live += size;
+	bytes_ += size;
+	return true;
+}
+
+const uint8_t* SegmentStore::read(const Location& location) {
+	Segment& segment = segments_[location.segment];
+	if (segment.file == -1) return nullptr;
+
+	// The latest segment grows past its view; map it again as a whole
+	if (location.offset + location.size > segment.mapped) {
+		unmap(segment);
+#ifdef _WIN32
+		HANDLE mapping = CreateFileMappingA((HANDLE)segment.file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (mapping == nullptr) return nullptr;
+		segment.mapping = (intptr_t)mapping;
+		segment.view = (const uint8_t*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		if (segment.view == nullptr) {
+			CloseHandle(mapping);
+			segment.mapping = 0;
+		}
+#else
+		void* view = mmap(nullptr, segment.size, PROT_READ, MAP_SHARED, (int)segment.file, 0);
+		segment.view = view == MAP_FAILED ? nullptr : (const uint8_t*)view;
+#endif
+		if (segment.view == nullptr) return nullptr;
+		segment.mapped = segment.size;
+	}
+	return segment.view + location.offset;
+}
+
+void SegmentStore::unmap(Segment& segment) {
+	if (segment.view == nullptr) return;
+#ifdef _WIN32
+	UnmapViewOfFile(segment.view);
+	CloseHandle((HANDLE)segment.mapping);
+	segment.mapping = 0;
+#else
+	munmap((void*)segment.view, segment.mapped);
+#endif
+	segment.view = nullptr;
+	segment.mapped = 0;
+}
+
+void SegmentStore::release(const Location& location) {
+	Segment& segment = segments_[location.segment];
+	segment.live -= location.size;
+	bytes_ -= location.size;
+	if (segment.live > 0) return;
+
+	remove(segment);
+	if (location.segment == current_) current_ = none;
+}
+
+void SegmentStore::remove(Segment& segment) {
+	if (segment.file == -1) return;
+	unmap(segment);
+#ifdef _WIN32
+	CloseHandle((HANDLE)segment.file);
+#else
+	::close((int)segment.file);
+#endif
+	std::error_code error;
+	std::filesystem::remove(segment.path, error);
+	segment = Segment();
+}
+
+void SegmentStore::close() {
+	for (Segment& segment : segments_) remove(segment);
+	segments_.clear();
+	current_ = none;
+	bytes_ = 0;
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/// <summary>
+///
+/// Append-only byte store backed by segment files in a directory. Records are appended to the latest segment
+/// until it reaches segment_bytes, then a new one is started. Reading maps the segment into memory, so only
+/// the pages of the records read are brought in. Records that are no longer needed are released, and a
+/// segment whose records all were is deleted, its number going to the next segment started. The files
+/// belong to the store and are deleted with it.
+///
+/// </summary>
+
+class SegmentStore
+{
+public:
+	static constexpr uint64_t segment_bytes = (uint64_t)256 << 20;
+
+	// Where a record was written
+	struct Location {
+		uint32_t segment = 0;
+		uint32_t size = 0;
+		uint64_t offset = 0;
+	};
+
+private:
+	struct Segment {
+		std::string path;
+		uint64_t size = 0;		// Bytes written
+		uint64_t live = 0;		// Bytes of the records not released
+		intptr_t file = -1;		// Descriptor or handle
+		intptr_t mapping = 0;	// Windows file mapping object
+		const uint8_t* view = nullptr;
+		uint64_t mapped = 0;	// Bytes of the file the view covers
+	};
+
+	std::string directory_;
+	std::string prefix_;	// Tells apart the files of stores sharing a directory
+	std::vector<Segment> segments_;	// Deleted ones have no file
+	static constexpr size_t none = (size_t)-1;
+	size_t current_ = none;			// Segment appended to
+	uint64_t bytes_ = 0;
+
+	bool create_segment();
+	void unmap(Segment& segment);
+
+	// Unmap, close and delete a segment's file
+	void remove(Segment& segment);
+
+public:
+	SegmentStore() {}
+	SegmentStore(const SegmentStore&) = delete;
+	SegmentStore& operator=(const SegmentStore&) = delete;
+	~SegmentStore() { close(); }
+
+	// Keep segments in a directory (the system's temporary directory if empty); records go there from the
+	// next append on
+	void set_directory(const std::string& directory) { directory_ = directory; }
+
+	// Append a record; false if it could not be written (e.g. the disk is full)
+	bool append(const uint8_t* data, size_t size, Location& location);
+
+	// The record's bytes, mapped from its segment; valid until the next call
+	const uint8_t* read(const Location& location);
+
+	// The record is no longer needed; deletes its segment once nothing in it is
+	void release(const Location& location);
+
+	// Bytes of the records not released
+	uint64_t bytes() const { return bytes_; }
+
+	// Unmap and delete every segment
+	void close();
+};
@@ -0,0 +1,69 @@
+#include "SoupSearch.h"
+#include "BitGrid.h"
+#include "CycleDetector.h"
+#include "ThreadPool.h"
+
+// splitmix64: a full-period generator whose every output is a good hash of the state, so each soup can
+// start its own stream from the seed and its index
+static uint64_t next_random(uint64_t& state) {
+	uint64_t z = (state += 0x9e3779b97f4a7c15ull);
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+	return z ^ (z >> 31);
+}
+
+SoupSearch::Soup SoupSearch::soup(uint64_t index) const {
+	uint64_t state = seed_ ^ next_random(index);
+
+	Soup soup;
+	for (int y = 0; y < soup_size; y += 4)
+	{
+		uint64_t bits = next_random(state);
+		for (int r = 0; r < 4; r++) soup[y + r] = (uint16_t)(bits >> (r * 16));
+	}
+	return soup;
+}
+
+SoupResult SoupSearch::run(uint64_t index) const {
+	BitGrid board(board_size_, board_size_);
+	board.set_rule(rule_);
+
+	Soup cells = soup(index);
+	int corner = (board_size_ - soup_size) / 2;
+	for (int y = 0; y < soup_size; y++)
+	{
+		for (int x = 0; x < soup_size; x++)
+		{
+			if ((cells[y] >> x) & 1) board.set(corner + x, corner + y, true);
+		}
+	}
+
+	// Every generation is observed, so the first repeat gives the exact period
+	CycleDetector cycles;
+	cycles.observe(board.hash(), 0);
+
+	SoupResult result = { index, max_generations_, 0, 0 };
+	for (uint64_t generation = 1; generation <= max_generations_; generation++)
+	{
+		board.evolve();
+
+		uint64_t period = cycles.observe(board.hash(), generation);
+		if (period != 0) {
+			result.generations = generation - period;
+			result.period = period;
+			break;
+		}
+	}
+	result.population = board.population();
+
+	if (census_ != nullptr && result.period != 0) census_->add(board, result.period);
+	return result;
+}
+
+std::vector<SoupResult> SoupSearch::run(uint64_t first, uint64_t count) const {
+	std::vector<SoupResult> results(count);
+	ThreadPool::shared().parallel_for(count, [&](size_t i) {
+		results[i] = run(first + i);
+	});
+	return results;
+}
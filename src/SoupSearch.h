@@ -0,0 +1,58 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "Census.h"
+#include "Rule.h"
+
+/// <summary>
+///
+/// Headless batch search over random soups: 16x16 patches filled from a seeded PRNG, each evolved on a board
+/// of its own until its state repeats. Soups are dealt out over the worker pool, one board per task, and
+/// every board goes through the vectorized row kernels. Soup i depends only on the seed and i, so a run
+/// gives the same results at any thread count.
+///
+/// Soups are not packed several to a board: escaping debris crosses dead gutters, so packed soups would no
+/// longer settle as they do alone. The board's sleeping tiles already keep the kernels on the soup's own cells.
+///
+/// </summary>
+
+struct SoupResult {
+	uint64_t index;
+	uint64_t generations;	// Generation the soup first repeated from, or the limit if it never did
+	uint64_t period;	// Period it settled into, 0 if it had not settled by the limit
+	uint64_t population;	// Live cells at the end
+};
+
+class SoupSearch
+{
+public:
+	static constexpr int soup_size = 16;
+
+	typedef std::array<uint16_t, soup_size> Soup;
+
+private:
+	Rule rule_;
+	uint64_t seed_;
+
+public:
+	// Soups start in the middle of a square board with dead edges, which debris escaping it dies on
+	int board_size_ = 256;
+	uint64_t max_generations_ = 20000;
+
+	// Objects of every settled soup are counted here, if set
+	Census* census_ = nullptr;
+
+	SoupSearch(const Rule& rule, uint64_t seed) : rule_(rule), seed_(seed) {}
+
+	// Rows of soup i, bit x of a row is column x; about half the cells are alive
+	Soup soup(uint64_t index) const;
+
+	// Evolve one soup until it settles
+	SoupResult run(uint64_t index) const;
+
+	// Soups first to first + count - 1, in order
+	std::vector<SoupResult> run(uint64_t first, uint64_t count) const;
+};
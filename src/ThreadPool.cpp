@@ -0,0 +1,112 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(unsigned threads) {
+	if (threads == 0) threads = std::max(std::thread::hardware_concurrency(), 1u);
+
+	for (unsigned i = 0; i < threads; i++) queues_.push_back(std::make_unique<Queue>());
+	for (unsigned i = 1; i < threads; i++) threads_.emplace_back(&ThreadPool::worker_main, this, (size_t)i);
+}
+
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		stopping_ = true;
+	}
+	wake_.notify_all();
+
+	for (std::thread& thread : threads_) thread.join();
+}
+
+ThreadPool& ThreadPool::shared() {
+	static ThreadPool pool(default_threads_);
+	return pool;
+}
+
+bool ThreadPool::pop(size_t self, size_t& task) {
+	// Own work first, newest end
+	{
+		Queue& own = *queues_[self];
+		std::lock_guard<std::mutex> lock(own.mutex);
+		if (!own.tasks.empty()) {
+			task = own.tasks.back();
+			own.tasks.pop_back();
+			return true;
+		}
+	}
+
+	// Steal the oldest task of the next thread that has any
+	for (size_t i = 1; i < queues_.size(); i++)
+	{
+		Queue& victim = *queues_[(self + i) % queues_.size()];
+		std::lock_guard<std::mutex> lock(victim.mutex);
+		if (!victim.tasks.empty()) {
+			task = victim.tasks.front();
+			victim.tasks.pop_front();
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void ThreadPool::work(size_t self) {
+	size_t task;
+	while (pop(self, task)) {
+		in_task_ = true;
+		(*job_)(task);
+		in_task_ = false;
+
+		if (--remaining_ == 0) {
+			std::lock_guard<std::mutex> lock(mutex_);
+			done_.notify_all();
+		}
+	}
+}
+
+void ThreadPool::worker_main(size_t self) {
+	uint64_t seen = 0;
+
+	for (;;) {
+		{
+			std::unique_lock<std::mutex> lock(mutex_);
+			wake_.wait(lock, [&] { return stopping_ || job_id_ != seen; });
+			if (stopping_) return;
+			seen = job_id_;
+		}
+
+		work(self);
+	}
+}
+
+void ThreadPool::parallel_for(size_t count, const std::function<void(size_t)>& task) {
+	if (count == 0) return;
+
+	if (count == 1 || queues_.size() == 1 || in_task_) {
+		for (size_t i = 0; i < count; i++) task(i);
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		job_ = &task;
+		remaining_ = count;
+
+		// Contiguous blocks keep neighbouring tiles on the same thread unless someone has to steal them
+		for (size_t q = 0; q < queues_.size(); q++)
+		{
+			std::lock_guard<std::mutex> queue_lock(queues_[q]->mutex);
+			size_t begin = count * q / queues_.size(), end = count * (q + 1) / queues_.size();
+			for (size_t i = begin; i < end; i++) queues_[q]->tasks.push_back(i);
+		}
+		job_id_++;
+	}
+	wake_.notify_all();
+
+	work(0);
+
+	std::unique_lock<std::mutex> lock(mutex_);
+	done_.wait(lock, [&] { return remaining_ == 0; });
+	job_ = nullptr;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// <summary>
+///
+/// Persistent worker pool with one task deque per thread. A job's indices are dealt out in contiguous
+/// blocks; each thread drains its own deque from the back and steals from the front of the others when
+/// it runs dry. Tasks must write disjoint outputs, which keeps results independent of the thread count.
+///
+/// </summary>
+
+class ThreadPool
+{
+private:
+	struct Queue {
+		std::mutex mutex;
+		std::deque<size_t> tasks;
+	};
+
+	// Queue 0 belongs to the thread calling parallel_for, which works along with the pool
+	std::vector<std::unique_ptr<Queue>> queues_;
+	std::vector<std::thread> threads_;
+
+	std::mutex mutex_;
+	std::condition_variable wake_;
+	std::condition_variable done_;
+
+	const std::function<void(size_t)>* job_ = nullptr;
+	uint64_t job_id_ = 0;
+	std::atomic<size_t> remaining_ = 0;
+	bool stopping_ = false;
+
+	inline static unsigned default_threads_ = 0;
+
+	// Set while the thread runs a task, so that a job started from inside one runs serially instead
+	inline static thread_local bool in_task_ = false;
+
+	bool pop(size_t self, size_t& task);
+	void work(size_t self);
+	void worker_main(size_t self);
+
+public:
+	// 0 threads: one per hardware thread
+	explicit ThreadPool(unsigned threads = 0);
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	// Threads taking part in a job, including the caller
+	size_t size() const { return queues_.size(); }
+
+	// Runs task(i) for every i in [0, count) and returns once all are done; one caller at a time. Called
+	// from inside a task, e.g. evolving one of many boards in parallel, it runs on the calling thread
+	void parallel_for(size_t count, const std::function<void(size_t)>& task);
+
+	// Pool used by the evolve engines; configure() only has an effect before its first use
+	static void configure(unsigned threads) { default_threads_ = threads; }
+	static ThreadPool& shared();
+};
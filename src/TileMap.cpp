@@ -0,0 +1,185 @@
+#include "TileMap.h"
+#include "EvolveKernel.h"
+#include "ThreadPool.h"
+
+#include <bit>
+#include <unordered_set>
+#include <vector>
+
+bool TileMap::get(int64_t x, int64_t y) const {
+	const Tile* tile = find(tile_of(x), tile_of(y));
+	return tile != nullptr && (((*tile)[y & 63] >> (x & 63)) & 1);
+}
+
+void TileMap::set(int64_t x, int64_t y, bool alive) {
+	Key k = key(tile_of(x), tile_of(y));
+	uint64_t bit = (uint64_t)1 << (x & 63);
+	int row = (int)(y & 63);
+
+	if (alive) {
+		uint64_t& word = tiles_.try_emplace(k, Tile{}).first->second[row];
+		hash_ ^= hash_word(position(k, row), word) ^ hash_word(position(k, row), word | bit);
+		population_ += (word & bit) == 0;
+		word |= bit;
+		return;
+	}
+
+	auto it = tiles_.find(k);
+	if (it == tiles_.end()) return;
+	uint64_t& word = it->second[row];
+	hash_ ^= hash_word(position(k, row), word) ^ hash_word(position(k, row), word & ~bit);
+	population_ -= (word & bit) != 0;
+	word &= ~bit;
+
+	for (uint64_t row : it->second) if (row) return;
+	tiles_.erase(it);
+}
+
+void TileMap::delta(const TileMap& other, Delta& delta) const {
+	delta.clear();
+	static const Tile empty{};
+
+	for (const auto& [k, tile] : other.tiles_)
+	{
+		auto it = tiles_.find(k);
+		const Tile& from = it == tiles_.end() ? empty : it->second;
+		for (int row = 0; row < tile_size; row++)
+		{
+			if (from[row] != tile[row]) delta.push_back({ k, from[row] ^ tile[row], row });
+		}
+	}
+	for (const auto& [k, tile] : tiles_)
+	{
+		if (other.tiles_.count(k)) continue;
+		for (int row = 0; row < tile_size; row++)
+		{
+			if (tile[row]) delta.push_back({ k, tile[row], row });
+		}
+	}
+}
+
+void TileMap::apply(const Delta& delta) {
+	for (const Change& change : delta)
+	{
+		uint64_t& word = tiles_.try_emplace(change.key, Tile{}).first->second[change.row];
+		hash_ ^= hash_word(position(change.key, change.row), word) ^ hash_word(position(change.key, change.row), word ^ change.bits);
+		population_ += std::popcount(word ^ change.bits) - std::popcount(word);
+		word ^= change.bits;
+	}
+
+	// Changes to a tile are listed together, so a tile emptied by the delta is checked once its last change is in
+	for (size_t i = 0; i < delta.size(); i++)
+	{
+		if (i + 1 < delta.size() && delta[i + 1].key == delta[i].key) continue;
+		auto it = tiles_.find(delta[i].key);
+		if (it == tiles_.end()) continue;
+
+		bool empty = true;
+		for (uint64_t row : it->second) empty &= row == 0;
+		if (empty) tiles_.erase(it);
+	}
+}
+
+void TileMap::evolve() {
+	// Every allocated tile, plus the missing neighbours across a border that has live cells on it
+	std::vector<Key> keys;
+	keys.reserve(tiles_.size() * 2);
+	std::unordered_set<Key, KeyHash> born;
+
+	for (const auto& [k, tile] : tiles_)
+	{
+		keys.push_back(k);
+
+		uint64_t left = 0, right = 0;
+		for (uint64_t row : tile) { left |= row & 1; right |= row >> 63; }
+		uint64_t top = tile[0], bottom = tile[tile_size - 1];
+
+		int64_t tx = k.x, ty = k.y;
+		auto reach = [&](int64_t dx, int64_t dy) {
+			Key n = key(tx + dx, ty + dy);
+			if (!tiles_.count(n) && born.insert(n).second) keys.push_back(n);
+		};
+
+		if (top) reach(0, -1);
+		if (bottom) reach(0, 1);
+		if (left) reach(-1, 0);
+		if (right) reach(1, 0);
+		if (top & 1) reach(-1, -1);
+		if (top >> 63) reach(1, -1);
+		if (bottom & 1) reach(-1, 1);
+		if (bottom >> 63) reach(1, 1);
+	}
+
+	const EvolveKernel& kernel = EvolveKernels::selected();
+	std::vector<Tile> results(keys.size());
+	std::vector<uint32_t> populations(keys.size());
+	std::vector<uint64_t> hash_changes(keys.size(), 0);
+
+	ThreadPool::shared().parallel_for(keys.size(), [&](size_t i) {
+		// The tile and a one-cell ring of its neighbours in BitGrid layout: three words wide, 66 rows tall
+		constexpr size_t stride = 3;
+		uint64_t src[stride * (tile_size + 2)] = {};
+		uint64_t dst[stride * (tile_size + 2)] = {};
+
+		int64_t tx = keys[i].x, ty = keys[i].y;
+		for (int dy = -1; dy <= 1; dy++)
+		{
+			for (int dx = -1; dx <= 1; dx++)
+			{
+				const Tile* tile = find(tx + dx, ty + dy);
+				if (tile == nullptr) continue;
+
+				int first = dy < 0 ? tile_size - 1 : 0, last = dy > 0 ? 0 : tile_size - 1;
+				for (int y = first; y <= last; y++) src[(size_t)(y + 1 + dy * tile_size) * stride + 1 + dx] = (*tile)[y];
+			}
+		}
+
+		// Tiles start on even rows, so local row parity is the board's
+		kernel.evolve_rows(&src[stride + 1], &dst[stride + 1], stride, 1, tile_size, 0, rule_);
+
+		const Tile* old = find(tx, ty);
+		uint32_t population = 0;
+		for (int y = 0; y < tile_size; y++)
+		{
+			results[i][y] = dst[(size_t)(y + 1) * stride + 1];
+			population += std::popcount(results[i][y]);
+
+			uint64_t before = old ? (*old)[y] : 0;
+			if (before != results[i][y]) hash_changes[i] ^= hash_word(position(keys[i], y), before) ^ hash_word(position(keys[i], y), results[i][y]);
+		}
+		populations[i] = population;
+	});
+
+	// Tiles that died out are freed
+	population_ = 0;
+	for (size_t i = 0; i < keys.size(); i++)
+	{
+		hash_ ^= hash_changes[i];
+		population_ += populations[i];
+		if (populations[i] == 0) tiles_.erase(keys[i]);
+		else tiles_[keys[i]] = results[i];
+	}
+}
+
+uint64_t TileMap::word(int64_t x, int64_t y) const {
+	int64_t tx = tile_of(x), ty = tile_of(y);
+	int shift = (int)(x & 63);
+
+	const Tile* tile = find(tx, ty);
+	uint64_t w = tile ? (*tile)[y & 63] >> shift : 0;
+	if (shift) {
+		const Tile* next = find(tx + 1, ty);
+		if (next) w |= (*next)[y & 63] << (64 - shift);
+	}
+	return w;
+}
+
+void TileMap::view(BitGrid& view, int64_t x, int64_t y) const {
+	for (int row = 0; row < view.height(); row++)
+	{
+		uint64_t* words = view.row(row);
+		for (size_t i = 0; i < view.words(); i++) words[i] = word(x + (int64_t)i * 64, y + row);
+		words[view.words() - 1] &= view.tail_mask();
+	}
+	view.wake_all();
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <array>
+#include <bit>
+#include <compare>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "BitGrid.h"
+
+/// <summary>
+///
+/// Unbounded plane stored as a hash map of 64x64 tiles keyed by tile coordinate. Tiles are allocated when
+/// activity reaches their border and dropped as soon as they are empty, so memory follows the live region
+/// rather than the window. Each tile is evolved through the same row kernel as BitGrid.
+///
+/// </summary>
+
+class TileMap
+{
+public:
+	static constexpr int tile_size = 64;
+
+	// Row y of a tile is rows[y], bit i is column i
+	typedef std::array<uint64_t, tile_size> Tile;
+
+	// Tile coordinate, kept in full so that tiles far out on the plane never share a key
+	struct Key {
+		int64_t x = 0, y = 0;
+
+		auto operator<=>(const Key&) const = default;
+	};
+
+	// Mixes both coordinates into 64 bits, for the map and for the hash positions
+	struct KeyHash {
+		size_t operator()(const Key& key) const { return (size_t)mix(key); }
+	};
+
+	// Rows where two planes differ: the tile's key, the row and the XOR of the two rows
+	struct Change {
+		Key key;
+		uint64_t bits;
+		int row;
+	};
+	typedef std::vector<Change> Delta;
+
+private:
+	std::unordered_map<Key, Tile, KeyHash> tiles_;
+	Rule rule_;
+
+	// XOR of hash_word over every row of every tile, at position mix(key) * 64 + row
+	uint64_t hash_ = 0;
+
+	// Live cells, counted per tile as the tiles are evolved
+	uint64_t population_ = 0;
+
+	static Key key(int64_t tx, int64_t ty) { return { tx, ty }; }
+
+	static uint64_t mix(const Key& key) {
+		uint64_t h = (uint64_t)key.x * 0x9e3779b97f4a7c15ull ^ std::rotl((uint64_t)key.y, 32);
+		h = (h ^ (h >> 30)) * 0xbf58476d1ce4e5b9ull;
+		h = (h ^ (h >> 27)) * 0x94d049bb133111ebull;
+		return h ^ (h >> 31);
+	}
+
+	static uint64_t position(const Key& key, int row) { return (mix(key) << 6) | (uint64_t)row; }
+
+	// Floor division by the tile size, for negative coordinates too
+	static int64_t tile_of(int64_t v) { return v >> 6; }
+
+	const Tile* find(int64_t tx, int64_t ty) const {
+		auto it = tiles_.find(key(tx, ty));
+		return it == tiles_.end() ? nullptr : &it->second;
+	}
+
+public:
+	bool get(int64_t x, int64_t y) const;
+	void set(int64_t x, int64_t y, bool alive);
+
+	void clear() { tiles_.clear(); hash_ = population_ = 0; }
+
+	// Only rules with Rule::needs_bounded_board() false are supported: B0 would bring the empty plane around
+	// the tiles to life and tiles hold no dying states
+	const Rule& rule() const { return rule_; }
+	void set_rule(const Rule& rule) { rule_ = rule; }
+
+	void evolve();
+
+	uint64_t population() const { return population_; }
+	size_t tile_count() const { return tiles_.size(); }
+
+	// Memory the tiles take, counting a node and a bucket of the map for each
+	size_t bytes() const {
+		return tiles_.size() * (sizeof(std::pair<const Key, Tile>) + 2 * sizeof(void*)) + tiles_.bucket_count() * sizeof(void*);
+	}
+
+	// Hash of the live cells, kept up to date from the rows that change; equal planes hash equally
+	uint64_t hash() const { return hash_; }
+
+	// The rows where other differs from this plane, so that apply() turns this plane into other
+	void delta(const TileMap& other, Delta& delta) const;
+
+	// XOR the rows of a delta into the plane, allocating and dropping tiles as needed; applying the same
+	// delta again undoes it
+	void apply(const Delta& delta);
+
+	// 64 cells of row y starting at column x (bit i is column x + i), any alignment
+	uint64_t word(int64_t x, int64_t y) const;
+
+	// Copy the window of the plane with top left corner (x, y) into view
+	void view(BitGrid& view, int64_t x, int64_t y) const;
+
+	// Visit every tile: fn(tile_x, tile_y, tile)
+	template <class F>
+	void for_each_tile(F fn) const {
+		for (const auto& [k, tile] : tiles_) fn(k.x, k.y, tile);
+	}
+};
@@ -0,0 +1,365 @@
+#include "Verifier.h"
+#include "EvolveKernel.h"
+#include "HashLife.h"
+#include "ThreadPool.h"
+#include "TileMap.h"
+
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <utility>
+
+static const char* topology_names[] = { "plane", "torus", "klein" };
+
+std::string VerifierCase::to_string() const {
+	std::string text = rule + " " + topology_names[(int)topology] + " " + std::to_string(width) + "x" + std::to_string(height) +
+		" " + std::to_string(generations) + " generations, cells:";
+	for (const auto& [x, y] : cells) text += " " + std::to_string(x) + "," + std::to_string(y);
+	return text;
+}
+
+// Cell across the edges of the board, or false if there is none (plane)
+static bool wrap(int& x, int& y, int width, int height, Topology topology) {
+	if (topology == Topology::plane) return x >= 0 && y >= 0 && x < width && y < height;
+
+	// A Klein bottle mirrors columns every time the top and bottom edges are crossed
+	int turns = y >= 0 ? y / height : -((height - 1 - y) / height);
+	y -= turns * height;
+	if (topology == Topology::klein && (turns & 1)) x = width - 1 - x;
+	x = ((x % width) + width) % width;
+	return true;
+}
+
+Verifier::States Verifier::reference(const States& states, int width, int height, const Rule& rule, Topology topology) {
+	States next(states.size(), 0);
+	for (int y = 0; y < height; y++)
+	{
+		for (int x = 0; x < width; x++)
+		{
+			// The cell and its 8 neighbours as Rule::next takes them; the rule masks out what its shape ignores
+			unsigned neighbourhood = 0;
+			for (int dy = -1; dy <= 1; dy++)
+			{
+				for (int dx = -1; dx <= 1; dx++)
+				{
+					int nx = x + dx, ny = y + dy;
+					if (wrap(nx, ny, width, height, topology) && states[(size_t)ny * width + nx] == 1) neighbourhood |= 1u << ((dy + 1) * 3 + dx + 1);
+				}
+			}
+
+			uint8_t state = states[(size_t)y * width + x];
+			uint8_t& result = next[(size_t)y * width + x];
+			if (state >= 2) result = state + 1 == rule.states ? 0 : state + 1;
+			else if (rule.next(neighbourhood, (y & 1) != 0)) result = 1;
+			else result = state == 1 && rule.multistate() ? 2 : 0;
+		}
+	}
+	return next;
+}
+
+Verifier::States Verifier::reference(const States& states, int width, int height, const LtlRule& rule, Topology topology) {
+	States next(states.size(), 0);
+	for (int y = 0; y < height; y++)
+	{
+		for (int x = 0; x < width; x++)
+		{
+			int count = 0;
+			for (int dy = -rule.radius; dy <= rule.radius; dy++)
+			{
+				for (int dx = -rule.radius; dx <= rule.radius; dx++)
+				{
+					if (rule.shape == LtlRule::Shape::von_neumann && std::abs(dx) + std::abs(dy) > rule.radius) continue;
+					if (dx == 0 && dy == 0 && !rule.middle) continue;
+
+					int nx = x + dx, ny = y + dy;
+					if (wrap(nx, ny, width, height, topology)) count += states[(size_t)ny * width + nx];
+				}
+			}
+
+			bool alive = states[(size_t)y * width + x] != 0;
+			next[(size_t)y * width + x] = alive ? count >= rule.survival_min && count <= rule.survival_max : count >= rule.birth_min && count <= rule.birth_max;
+		}
+	}
+	return next;
+}
+
+Verifier::Verifier() {
+	// Kept for the lifetime of the verifier, as boards refer to them
+	static const std::vector<EvolveKernel> kernels = EvolveKernels::supported();
+
+	for (const EvolveKernel& kernel : kernels)
+	{
+		const EvolveKernel* k = &kernel;
+		engines_.push_back({ std::string("tiles/") + kernel.name, false,
+			[](const Rule* rule, const LtlRule*, Topology) { return rule != nullptr; },
+			[k](BitGrid& board, const LtlRule*, int generations) {
+				board.set_kernel(k);
+				for (int g = 0; g < generations; g++) board.evolve();
+			} });
+		engines_.push_back({ std::string("blocks/") + kernel.name, false,
+			[](const Rule* rule, const LtlRule*, Topology topology) { return rule != nullptr && topology == Topology::plane && !rule->multistate(); },
+			[k](BitGrid& board, const LtlRule*, int generations) {
+				board.set_kernel(k);
+				board.evolve_n(generations);
+			} });
+	}
+
+	engines_.push_back({ "tilemap", true,
+		[](const Rule* rule, const LtlRule*, Topology topology) { return rule != nullptr && !rule->needs_bounded_board() && topology == Topology::plane; },
+		[](BitGrid& board, const LtlRule*, int generations) {
+			TileMap plane;
+			plane.set_rule(board.rule());
+			for (int y = 0; y < board.height(); y++)
+			{
+				for (int x = 0; x < board.width(); x++)
+				{
+					if (board.get(x, y)) plane.set(x, y, true);
+				}
+			}
+			for (int g = 0; g < generations; g++) plane.evolve();
+			plane.view(board, 0, 0);
+		} });
+
+	// Row parity is lost in memoized nodes, so hexagonal rules have no HashLife equivalent
+	engines_.push_back({ "hashlife", true,
+		[](const Rule* rule, const LtlRule*, Topology topology) {
+			return rule != nullptr && !rule->needs_bounded_board() && rule->shape != Rule::Shape::hexagonal && topology == Topology::plane;
+		},
+		[](BitGrid& board, const LtlRule*, int generations) {
+			auto hashlife = std::make_unique<HashLife>();
+			hashlife->set_rule(board.rule());
+			hashlife->import(board);
+			for (int k = 0; (generations >> k) != 0; k++)
+			{
+				if ((generations >> k) & 1) hashlife->advance(k);
+			}
+			hashlife->export_to(board);
+		} });
+
+	engines_.push_back({ "larger-than-life", false,
+		[](const Rule*, const LtlRule* ltl, Topology) { return ltl != nullptr; },
+		[](BitGrid& board, const LtlRule* ltl, int generations) {
+			LargerThanLife engine;
+			engine.set_rule(*ltl);
+			for (int g = 0; g < generations; g++) engine.evolve(board);
+		} });
+}
+
+Verifier::States Verifier::expected(const VerifierCase& c, int pad) {
+	Rule rule;
+	LtlRule ltl;
+	bool outer_totalistic = Rule::parse(c.rule, rule);
+	if (!outer_totalistic) LtlRule::parse(c.rule, ltl);
+
+	int width = c.width + 2 * pad, height = c.height + 2 * pad;
+	States states((size_t)width * height, 0);
+	for (const auto& [x, y] : c.cells) states[(size_t)(y + pad) * width + x + pad] = 1;
+
+	for (int g = 0; g < c.generations; g++) states = outer_totalistic ? reference(states, width, height, rule, c.topology) : reference(states, width, height, ltl, c.topology);
+	return states;
+}
+
+bool Verifier::matches(const Engine& engine, const VerifierCase& c, const States* reference) const {
+	Rule rule;
+	LtlRule ltl;
+	bool outer_totalistic = Rule::parse(c.rule, rule);
+	if (!outer_totalistic && !LtlRule::parse(c.rule, ltl)) return true;
+
+	int pad = padding(engine, c);
+	int width = c.width + 2 * pad, height = c.height + 2 * pad;
+
+	BitGrid board(width, height);
+	board.set_topology(c.topology);
+	if (outer_totalistic) board.set_rule(rule);
+	for (const auto& [x, y] : c.cells) board.set(x + pad, y + pad, true);
+	engine.evolve(board, outer_totalistic ? nullptr : &ltl, c.generations);
+
+	States computed;
+	if (reference == nullptr) {
+		computed = expected(c, pad);
+		reference = &computed;
+	}
+
+	for (int y = 0; y < height; y++)
+	{
+		for (int x = 0; x < width; x++)
+		{
+			if (board.state(x, y) != (*reference)[(size_t)y * width + x]) return false;
+		}
+	}
+	return true;
+}
+
+VerifierCase Verifier::shrink(const Engine& engine, VerifierCase c) const {
+	// Earliest generation that differs
+	for (int g = 1; g < c.generations; g++)
+	{
+		VerifierCase shorter = c;
+		shorter.generations = g;
+		if (!matches(engine, shorter)) {
+			c = shorter;
+			break;
+		}
+	}
+
+	// Drop runs of starting cells, halving the run length whenever none can go
+	for (size_t run = std::max<size_t>(c.cells.size() / 2, 1); run > 0;)
+	{
+		bool dropped = false;
+		for (size_t start = 0; start < c.cells.size();)
+		{
+			VerifierCase fewer = c;
+			fewer.cells.erase(fewer.cells.begin() + start, fewer.cells.begin() + std::min(start + run, fewer.cells.size()));
+			if (!matches(engine, fewer)) {
+				c = fewer;
+				dropped = true;
+			}
+			else start += run;
+		}
+		if (!dropped) run /= 2;
+	}
+	return c;
+}
+
+std::vector<VerifierMismatch> Verifier::compare(const VerifierCase& c, uint64_t& comparisons) const {
+	std::vector<VerifierMismatch> mismatches;
+
+	Rule rule;
+	LtlRule ltl;
+	bool outer_totalistic = Rule::parse(c.rule, rule);
+	if (!outer_totalistic && !LtlRule::parse(c.rule, ltl)) return mismatches;
+
+	// One reference per padding, shared by the engines
+	std::vector<std::pair<int, States>> references;
+
+	for (const Engine& engine : engines_)
+	{
+		if (!engine.applies(outer_totalistic ? &rule : nullptr, outer_totalistic ? nullptr : &ltl, c.topology)) continue;
+
+		int pad = padding(engine, c);
+		auto reference = std::find_if(references.begin(), references.end(), [&](const auto& r) { return r.first == pad; });
+		if (reference == references.end()) reference = references.insert(references.end(), { pad, expected(c, pad) });
+
+		comparisons++;
+		if (!matches(engine, c, &reference->second)) mismatches.push_back({ engine.name, shrink(engine, c) });
+	}
+	return mismatches;
+}
+
+bool Verifier::check(const VerifierCase& c) {
+	std::vector<VerifierMismatch> found = compare(c, comparisons_);
+	mismatches_.insert(mismatches_.end(), found.begin(), found.end());
+	return found.empty();
+}
+
+bool Verifier::run(uint32_t seed, int rounds) {
+	std::vector<std::string> rules;
+	for (const NamedRule& preset : preset_rules) rules.push_back(preset.rule.to_string());
+	for (const char* rule : { "B34/S34", "B0/S8", "B013/S0124", "B1/S1", "B2/S345/C4", "B3/S23/C40", "B2n3/S23-q", "B3/S2-i34q",
+		"B2/S34H", "B24/S135/C5H", "B2/S013V", "B0/S2V", "R1,C0,M1,S3..4,B3..3,NM", "R2,C0,M0,S3..5,B4..6,NN" })
+	{
+		rules.push_back(rule);
+	}
+	for (const NamedLtlRule& preset : preset_ltl_rules) rules.push_back(preset.rule);
+
+	// Widths around a word boundary; even heights so that hexagonal rules can wrap
+	const std::pair<int, int> sizes[] = { { 70, 34 }, { 64, 64 }, { 130, 66 } };
+	// Larger than Life references count up to 441 cells each
+	const int generations = 12, ltl_generations = 3;
+
+	// Glider, lightweight spaceship, blinker, pentadecathlon
+	const char* const known[] = { ".O.|..O|OOO", ".O..O|O....|O...O|OOOO.", "OOO", "..O....O..|OO.OOOO.OO|..O....O.." };
+
+	std::vector<VerifierCase> cases;
+	std::mt19937 random(seed);
+	for (const std::string& rule_text : rules)
+	{
+		Rule rule;
+		bool outer_totalistic = Rule::parse(rule_text, rule);
+		bool hexagonal = outer_totalistic && rule.shape == Rule::Shape::hexagonal;
+
+		for (Topology topology : { Topology::plane, Topology::torus, Topology::klein })
+		{
+			if (hexagonal && topology == Topology::klein) continue;
+
+			for (const auto& [width, height] : sizes)
+			{
+				VerifierCase c = { rule_text, topology, width, height, outer_totalistic ? generations : ltl_generations, {} };
+
+				// Random soups of varying density
+				for (int round = 0; round < rounds; round++)
+				{
+					c.cells.clear();
+					unsigned density = 2 + random() % 5;
+					for (int y = 0; y < height; y++)
+					{
+						for (int x = 0; x < width; x++)
+						{
+							if (random() % 8 < density) c.cells.push_back({ x, y });
+						}
+					}
+					cases.push_back(c);
+				}
+
+				// Cells crowding the edges and corners, where the halo and the tail of the rows are
+				c.cells.clear();
+				for (int y = 0; y < height; y++)
+				{
+					for (int x = 0; x < width; x++)
+					{
+						bool edge = x < 2 || y < 2 || x >= width - 2 || y >= height - 2;
+						if (edge && random() % 2) c.cells.push_back({ x, y });
+					}
+				}
+				cases.push_back(c);
+
+				// Known patterns in all 8 orientations: mirrored into the four corners, heading off them, as written
+				// and transposed, plus one in the middle
+				for (const char* pattern : known)
+				{
+					int x = 0, y = 0;
+					std::vector<std::pair<int, int>> cells;
+					for (const char* p = pattern; *p; p++)
+					{
+						if (*p == '|') { y++; x = 0; continue; }
+						if (*p == 'O') cells.push_back({ x, y });
+						x++;
+					}
+
+					for (bool transposed : { false, true })
+					{
+						c.cells.clear();
+						for (int corner = 0; corner < 5; corner++)
+						{
+							for (auto [px, py] : cells)
+							{
+								if (transposed) std::swap(px, py);
+								int cx = corner == 4 ? width / 2 : (corner & 1) ? width - 1 - px : px;
+								int cy = corner == 4 ? height / 2 + py : (corner & 2) ? height - 1 - py : py;
+								if (corner == 4) cx += px;
+								c.cells.push_back({ cx, cy });
+							}
+						}
+						std::sort(c.cells.begin(), c.cells.end());
+						c.cells.erase(std::unique(c.cells.begin(), c.cells.end()), c.cells.end());
+						cases.push_back(c);
+					}
+				}
+			}
+		}
+	}
+
+	// Cases are independent; their results are gathered in order so the report does not depend on threads
+	std::vector<std::vector<VerifierMismatch>> found(cases.size());
+	std::vector<uint64_t> comparisons(cases.size(), 0);
+	ThreadPool::shared().parallel_for(cases.size(), [&](size_t i) {
+		found[i] = compare(cases[i], comparisons[i]);
+	});
+
+	for (size_t i = 0; i < cases.size(); i++)
+	{
+		comparisons_ += comparisons[i];
+		mismatches_.insert(mismatches_.end(), found[i].begin(), found[i].end());
+	}
+	return mismatches_.empty();
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "BitGrid.h"
+#include "LargerThanLife.h"
+#include "Rule.h"
+
+/// <summary>
+///
+/// Differential verifier for the evolve engines. A reference evolves boards cell by cell straight from the
+/// rule's definition; every engine (BitGrid under each supported kernel, tile by tile and in temporal blocks,
+/// TileMap, HashLife and Larger than Life) evolves the same boards, and the results must match bit for bit.
+/// Boards are random soups, patterns crowding the edges and known oscillators and spaceships, under a spread
+/// of rules and every topology they run on.
+///
+/// A mismatch is shrunk before it is reported: first to the earliest generation that differs, then to as few
+/// starting cells as still reproduce it.
+///
+/// </summary>
+
+struct VerifierCase {
+	std::string rule;	// B/S or Larger than Life rulestring
+	Topology topology = Topology::plane;
+	int width = 0, height = 0;
+	int generations = 0;
+	std::vector<std::pair<int, int>> cells;	// Live cells at the start
+
+	// One line: rule, topology, size, generations and the cells
+	std::string to_string() const;
+};
+
+struct VerifierMismatch {
+	std::string engine;
+	VerifierCase reproducer;
+};
+
+class Verifier
+{
+public:
+	// Cell states, row by row: 0 dead, 1 alive, 2 and up dying
+	typedef std::vector<uint8_t> States;
+
+	struct Engine {
+		std::string name;
+		bool unbounded;	// Evolves an unbounded plane: compared on a board padded beyond anything the pattern reaches
+		std::function<bool(const Rule* rule, const LtlRule* ltl, Topology topology)> applies;
+		std::function<void(BitGrid& board, const LtlRule* ltl, int generations)> evolve;
+	};
+
+private:
+	std::vector<Engine> engines_;
+	std::vector<VerifierMismatch> mismatches_;
+	uint64_t comparisons_ = 0;
+
+	// Reference result of a case on a board padded by pad cells all round
+	static States expected(const VerifierCase& c, int pad);
+
+	// Whether the engine agrees with the reference (computed here unless given)
+	bool matches(const Engine& engine, const VerifierCase& c, const States* reference = nullptr) const;
+
+	// Unbounded engines get room for the pattern to grow a cell per generation, an even amount to keep the
+	// parity of rows
+	static int padding(const Engine& engine, const VerifierCase& c) { return engine.unbounded ? (c.generations + 2) & ~1 : 0; }
+
+	VerifierCase shrink(const Engine& engine, VerifierCase c) const;
+
+	// Run every engine that applies over a case; returns the shrunk mismatches and counts the comparisons
+	std::vector<VerifierMismatch> compare(const VerifierCase& c, uint64_t& comparisons) const;
+
+public:
+	Verifier();
+
+	// Next generation computed cell by cell
+	static States reference(const States& states, int width, int height, const Rule& rule, Topology topology);
+	static States reference(const States& states, int width, int height, const LtlRule& rule, Topology topology);
+
+	const std::vector<Engine>& engines() const { return engines_; }
+
+	// Check every engine on one case; false if any disagrees with the reference
+	bool check(const VerifierCase& c);
+
+	// The whole suite: known patterns, edge cases and rounds of random soups from seed, spread over the worker
+	// pool; false on any mismatch
+	bool run(uint32_t seed, int rounds);
+
+	const std::vector<VerifierMismatch>& mismatches() const { return mismatches_; }
+	uint64_t comparisons() const { return comparisons_; }
+};
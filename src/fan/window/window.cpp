@@ -2187,6 +2187,20 @@ uint32_t fan::window_t::handle_events() {
   return m_event_flags;
 }
 
+void fan::window_t::wait_events() {
+  #ifdef fan_platform_windows
+
+  WaitMessage();
+
+  #elif defined(fan_platform_unix)
+
+  // Blocks until an event is queued without removing it
+  XEvent event;
+  XPeekEvent(fan::sys::m_display, &event);
+
+  #endif
+}
+
 void* fan::window_t::get_user_data() const
 {
   return m_user_data;
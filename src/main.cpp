@@ -31,8 +31,16 @@
 
 #include "Grid.h"
 #include "Utils.h"
+#include "ThreadPool.h"
+#include "EvolveKernel.h"
+#include "SoupSearch.h"
+#include "Verifier.h"
 
 #include <fan/graphics/graphics.h>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <map>
 #include <thread>
 
 
@@ -43,15 +51,138 @@
 // - Measuring tape (in square units)
 // 
 //  Known bugs:
-//  - Crash if a tick causes a cell generation that overlaps a corner .. corners overlap handling, TBD!
 //  - Not a bug, but tickrate works counter-intuitively; lowering increases simulation speed & vice versa
 
 
-int main()
+int main(int argc, char** argv)
 {
     //  Grid divisor
     int subdivs = 50;
 
+	// Command line: --threads N (evolve threads, default one per hardware thread), --gens-per-tick N, --unbounded,
+	// --topology plane|torus|klein, --rule B3/S23 (B2/S34H hexagonal, B2/S013V von Neumann, or a Larger than Life
+	// rule such as R5,C0,M1,S34..58,B34..45,NM), --bench (time every evolve kernel and exit), --settle-period N
+	// (longest period a settled board repeats with, 0 for none), --pause-when-settled (pause and idle once settled),
+	// --soups N (run N random 16x16 soups headless, starting from --seed S, writing each outcome to --soup-log FILE;
+	// --census counts the objects they settle into), --verify N (compare every engine with a cell-by-cell reference over
+	// the conformance cases and N rounds of random soups from --seed, check that a thinned-out history still
+	// rebuilds every slot, and exit), --history-mb N (memory the history may take before older generations are
+	// spilled to disk and then thinned out), --history-disk-mb N (disk space it may spill to, 0 for none),
+	// --history-dir DIR (where to spill, the temporary directory by default)
+	int generations_per_tick = 1;
+	uint64_t settle_period = 2;
+	bool pause_when_settled = false;
+	uint64_t soups = 0, seed = 1;
+	std::string soup_log;
+	bool census = false;
+	int verify_rounds = 0;
+	size_t history_mb = 1024;
+	uint64_t history_disk_mb = 16384;
+	std::string history_dir;
+	bool unbounded = false;
+	bool bench = false;
+	Topology topology = Topology::plane;
+	std::string rule = "B3/S23";
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if (arg == "--threads" && i + 1 < argc) ThreadPool::configure(std::atoi(argv[++i]));
+		else if (arg == "--gens-per-tick" && i + 1 < argc) generations_per_tick = std::max(std::atoi(argv[++i]), 1);
+		else if (arg == "--unbounded") unbounded = true;
+		else if (arg == "--topology" && i + 1 < argc) {
+			std::string name = argv[++i];
+			if (name == "torus") topology = Topology::torus;
+			else if (name == "klein") topology = Topology::klein;
+		}
+		else if (arg == "--rule" && i + 1 < argc) rule = argv[++i];
+		else if (arg == "--bench") bench = true;
+		else if (arg == "--settle-period" && i + 1 < argc) settle_period = (uint64_t)std::max(std::atoi(argv[++i]), 0);
+		else if (arg == "--pause-when-settled") pause_when_settled = true;
+		else if (arg == "--soups" && i + 1 < argc) soups = std::strtoull(argv[++i], nullptr, 10);
+		else if (arg == "--seed" && i + 1 < argc) seed = std::strtoull(argv[++i], nullptr, 10);
+		else if (arg == "--soup-log" && i + 1 < argc) soup_log = argv[++i];
+		else if (arg == "--census") census = true;
+		else if (arg == "--verify" && i + 1 < argc) verify_rounds = std::max(std::atoi(argv[++i]), 1);
+		else if (arg == "--history-mb" && i + 1 < argc) history_mb = std::max(std::atoi(argv[++i]), 1);
+		else if (arg == "--history-disk-mb" && i + 1 < argc) history_disk_mb = std::strtoull(argv[++i], nullptr, 10);
+		else if (arg == "--history-dir" && i + 1 < argc) history_dir = argv[++i];
+	}
+
+	// The kernels are checked against each other before anything runs; a kernel that disagrees is left out
+	for (const char* name : EvolveKernels::rejected()) fan::print("Evolve kernel", name, "disagrees with the scalar kernel and is not used");
+
+	if (bench) {
+		// A preset, the generic kernel, a non-totalistic rule and the other neighbourhoods, plus the requested rule
+		std::vector<std::string> rules = { "B3/S23", "B34/S34", "B2n3/S23-q", "B2/S34H", "B2/S013V" };
+		if (std::find(rules.begin(), rules.end(), rule) == rules.end()) rules.push_back(rule);
+
+		for (const std::string& rulestring : rules)
+		{
+			Rule parsed;
+			if (!Rule::parse(rulestring, parsed)) continue;
+			for (const EvolveKernel& kernel : EvolveKernels::supported())
+			{
+				fan::print(rulestring, kernel.name, EvolveKernels::benchmark(kernel, parsed), "ns/cell");
+			}
+		}
+		return 0;
+	}
+
+	if (verify_rounds > 0) {
+		Verifier verifier;
+		bool identical = verifier.run((uint32_t)seed, verify_rounds);
+
+		for (const VerifierMismatch& mismatch : verifier.mismatches()) fan::print("Mismatch in", mismatch.engine, ":", mismatch.reproducer.to_string());
+		fan::print(verifier.comparisons(), "comparisons over", verifier.engines().size(), "engines,", verifier.mismatches().size(), "mismatches");
+
+		bool history = History::self_check((uint32_t)seed);
+		fan::print(history ? "History rebuilds every thinned-out slot" : "History rebuilds a thinned-out slot wrong");
+		return identical && history ? 0 : 1;
+	}
+
+	if (soups > 0) {
+		Rule parsed;
+		if (!Rule::parse(rule, parsed)) {
+			fan::print("Invalid rule:", rule);
+			return 1;
+		}
+
+		SoupSearch search(parsed, seed);
+		Census objects;
+		if (census) search.census_ = &objects;
+		auto start = std::chrono::steady_clock::now();
+		std::vector<SoupResult> results = search.run(0, soups);
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		// Soups per period they settled into (0: not settled by the limit)
+		std::map<uint64_t, uint64_t> periods;
+		for (const SoupResult& result : results) periods[result.period]++;
+
+		fan::print("Soups:", soups, "in", seconds, "s,", soups / seconds, "soups/second on", ThreadPool::shared().size(), "threads");
+		for (const auto& [period, count] : periods)
+		{
+			if (period == 0) fan::print("Not settled after", search.max_generations_, "generations:", count);
+			else fan::print("Period", period, ":", count);
+		}
+
+		// Most common objects first
+		if (census) {
+			std::vector<std::pair<uint64_t, std::string>> ranked;
+			for (const auto& [code, count] : objects.counts()) ranked.push_back({ count, code });
+			std::sort(ranked.rbegin(), ranked.rend());
+
+			fan::print("Objects:", ranked.size(), "kinds");
+			for (const auto& [count, code] : ranked) fan::print(code, count);
+		}
+
+		if (!soup_log.empty()) {
+			std::ofstream log(soup_log);
+			log << "soup,generations,period,population\n";
+			for (const SoupResult& result : results) log << result.index << ',' << result.generations << ',' << result.period << ',' << result.population << '\n';
+		}
+		return 0;
+	}
+
 	fan::window_t window;
 	window.open(Utils::FloorToPerfectSquare(fan::get_screen_resolution()) - 100, "Conway's Game of Life");
 	fan::opengl::context_t context;
@@ -70,6 +201,13 @@ int main()
   fan::set_console_visibility(false);
 
   Grid grid(&window, &context, subdivs);
+  grid.generations_per_tick_ = generations_per_tick;
+  grid.settle_period_ = settle_period;
+  grid.pause_when_settled_ = pause_when_settled;
+  grid.set_history_budget(history_mb << 20, history_disk_mb << 20, history_dir);
+  grid.set_rule(rule);
+  grid.set_unbounded(unbounded);
+  grid.set_topology(topology);
 
 	/* Key bindings */
 	window.add_key_callback(fan::mouse_left, fan::key_state::press, &grid, [](fan::window_t*, uint16_t key, void* userptr) { 
@@ -104,9 +242,13 @@ int main()
 
 	// Shift+T+ScrollUp: Evolve or forward to next generation depending on if the generation is already recorded or not. 
 	// Shift+T+ScrollDown: Devolve to earlier generation if it exists
+	// Ctrl+Shift+T+ScrollUp: Fast-forward several generations at once
 	window.add_keys_callback(&grid, [](fan::window_t*, uint16_t key, fan::key_state, void* userptr) {
 		Grid& grid = *(Grid*)userptr;
-		if (grid.window->key_press(fan::key_t) && key == fan::mouse_scroll_up) {
+		if (grid.window->key_press(fan::key_t) && grid.window->key_press(fan::key_control) && key == fan::mouse_scroll_up) {
+			grid.fast_forward(grid.fast_forward_step_);
+		}
+		else if (grid.window->key_press(fan::key_t) && key == fan::mouse_scroll_up) {
 			grid.evolve();
 		}
 		else if (grid.window->key_press(fan::key_t) && key == fan::mouse_scroll_down) {
@@ -114,5 +256,87 @@ int main()
 		}
 	});
 
+	// L: Leap 2^n generations ahead; PageUp/PageDown: double/halve the leap
+	window.add_key_callback(fan::key_l, fan::key_state::press, &grid, [](fan::window_t* w, uint16_t key, void* userptr) {
+		((Grid*)userptr)->leap();
+	});
+	window.add_key_callback(fan::key_page_up, fan::key_state::press, &grid, [](fan::window_t* w, uint16_t key, void* userptr) {
+		Grid& grid = *(Grid*)userptr;
+		grid.leap_exponent_ = std::min(grid.leap_exponent_ + 1, 40);
+		fan::print("Leap: 2 ^", grid.leap_exponent_, "generations");
+	});
+	window.add_key_callback(fan::key_page_down, fan::key_state::press, &grid, [](fan::window_t* w, uint16_t key, void* userptr) {
+		Grid& grid = *(Grid*)userptr;
+		grid.leap_exponent_ = std::max(grid.leap_exponent_ - 1, 0);
+		fan::print("Leap: 2 ^", grid.leap_exponent_, "generations");
+	});
+
+	// O: Cycle the board's topology (plane, torus, Klein bottle)
+	window.add_key_callback(fan::key_o, fan::key_state::press, &grid, [](fan::window_t* w, uint16_t key, void* userptr) {
+		Grid& grid = *(Grid*)userptr;
+		grid.set_topology((Topology)(((int)grid.get_topology() + 1) % 3));
+	});
+
+	// R: Cycle through the preset rules (Life, HighLife, Day & Night, ...)
+	window.add_key_callback(fan::key_r, fan::key_state::press, &grid, [](fan::window_t* w, uint16_t key, void* userptr) {
+		Grid& grid = *(Grid*)userptr;
+		const size_t count = sizeof(preset_rules) / sizeof(preset_rules[0]);
+
+		size_t next = 0;
+		for (size_t i = 0; i < count; i++)
+		{
+			if (preset_rules[i].rule == grid.get_rule()) next = (i + 1) % count;
+		}
+		while (grid.is_unbounded() && preset_rules[next].rule.needs_bounded_board()) next = (next + 1) % count;
+		grid.set_rule(preset_rules[next].rule);
+	});
+
+	// N: Cycle the neighbourhood of the current rule (Moore, hexagonal, von Neumann); counts the new one cannot
+	// reach and Hensel letters are dropped
+	window.add_key_callback(fan::key_n, fan::key_state::press, &grid, [](fan::window_t* w, uint16_t key, void* userptr) {
+		Grid& grid = *(Grid*)userptr;
+		const Rule& current = grid.get_rule();
+
+		Rule rule(current.birth, current.survival, current.states, (Rule::Shape)(((int)current.shape + 1) % 3));
+		uint16_t possible = (uint16_t)((2 << rule.max_neighbours()) - 1);
+		rule.birth &= possible;
+		rule.survival &= possible;
+		grid.set_rule(rule);
+	});
+
+	// U: Toggle unbounded plane; arrow keys: move the window over it
+	window.add_key_callback(fan::key_u, fan::key_state::press, &grid, [](fan::window_t* w, uint16_t key, void* userptr) {
+		Grid& grid = *(Grid*)userptr;
+		grid.set_unbounded(!grid.is_unbounded());
+	});
+	window.add_keys_callback(&grid, [](fan::window_t*, uint16_t key, fan::key_state state, void* userptr) {
+		Grid& grid = *(Grid*)userptr;
+		if (state == fan::key_state::release) return;
+
+		const int step = 8;
+		if (key == fan::key_left) grid.pan(-step, 0);
+		else if (key == fan::key_right) grid.pan(step, 0);
+		else if (key == fan::key_up) grid.pan(0, -step);
+		else if (key == fan::key_down) grid.pan(0, step);
+	});
+
+	// H: Toggle the timeline, dragged with LMB to go back and forth through the history
+	window.add_key_callback(fan::key_h, fan::key_state::press, &grid, [](fan::window_t* w, uint16_t key, void* userptr) {
+		((Grid*)userptr)->toggle_timeline();
+	});
+
+	// C: Print the objects of the board once it repeats
+	window.add_key_callback(fan::key_c, fan::key_state::press, &grid, [](fan::window_t* w, uint16_t key, void* userptr) {
+		((Grid*)userptr)->print_census();
+	});
+
+	// I: Print the generation, population and live region
+	window.add_key_callback(fan::key_i, fan::key_state::press, &grid, [](fan::window_t* w, uint16_t key, void* userptr) {
+		Grid::Stats stats = ((Grid*)userptr)->stats();
+		fan::print("Generation:", stats.generation, "population:", stats.population, "bounds:", stats.bounds.left, stats.bounds.top, stats.bounds.width(), "x", stats.bounds.height());
+		if (stats.period) fan::print("Period:", stats.period, stats.settled ? "(settled)" : "");
+		fan::print("History:", stats.history_slots, "slots,", stats.history_stored, "stored,", stats.history_bytes / 1024, "KiB in memory,", stats.history_disk_bytes / 1024, "KiB on disk");
+	});
+
   grid.run();
 }
\ No newline at end of file